@@ -0,0 +1,379 @@
+#include "blob.cpp"
+#include "reference.cpp"
+#include "golden.cpp"
+
+/* Scenario maps are built at this tile offset, far from any level geometry.
+ * The bench refuses to run unless the area is empty in the map, and empties
+ * it again after each run. */
+const int BLOB_BENCH_TX = -4000;
+const int BLOB_BENCH_TY = -4000;
+const int BLOB_BENCH_W = 32;
+const int BLOB_BENCH_H = 20;
+
+const int BLOB_BENCH_FRAMES = 240;
+const int BLOB_BENCH_SAMPLE = 10; /* Frames between trajectory samples */
+const float BLOB_BENCH_TOLERANCE = 0.5; /* Pixels */
+const int BLOB_BENCH_COPIES = 32; /* Blobs stepped together when timing */
+
+/* Tile shapes used by the scenario maps. BLOB_BENCH_RAMP stands for the
+ * 45 degree slope rising to the right, whose shape index find_ramp() asks
+ * the engine for. */
+const int BLOB_BENCH_FULL = 0;
+const int BLOB_BENCH_RAMP = -1;
+const int BLOB_BENCH_SHAPES = 21;
+
+funcdef void blob_bench_input(scriptenemy@ self, int frame);
+
+class blob_scenario {
+  string name;
+  array<int> rects; /* Solid tiles as tx0, ty0, tx1, ty1, shape */
+  float x; /* Start position and speed, relative to the map */
+  float y;
+  float x_speed;
+  float y_speed;
+  blob_bench_input@ input;
+
+  blob_scenario(const string &in name, float x, float y, float x_speed,
+                float y_speed, blob_bench_input@ input) {
+    this.name = name;
+    this.x = x;
+    this.y = y;
+    this.x_speed = x_speed;
+    this.y_speed = y_speed;
+    @this.input = @input;
+  }
+
+  void fill(int tx0, int ty0, int tx1, int ty1, int shape = BLOB_BENCH_FULL) {
+    rects.insertLast(tx0);
+    rects.insertLast(ty0);
+    rects.insertLast(tx1);
+    rects.insertLast(ty1);
+    rects.insertLast(shape);
+  }
+
+  void add_floor() {
+    fill(0, BLOB_BENCH_H - 1, BLOB_BENCH_W - 1, BLOB_BENCH_H - 1);
+  }
+}
+
+void blob_input_none(scriptenemy@ self, int frame) {
+}
+
+void blob_input_roll_left(scriptenemy@ self, int frame) {
+  self.x_intent(-1);
+}
+
+void blob_input_dash_spam(scriptenemy@ self, int frame) {
+  self.x_intent((frame / 60) % 2 == 0 ? 1 : -1);
+  if (frame % 15 == 0) {
+    self.dash_intent(1);
+  }
+}
+
+void blob_input_jump_spam(scriptenemy@ self, int frame) {
+  if (frame % 30 == 0) {
+    self.jump_intent(1);
+  }
+}
+
+/* Usage:
+ *
+ * Create a blob_bench and call run_all() (see the script's benchmark option).
+ * Each canned scenario builds a small tile map out of the way of the level,
+ * then steps a blob that isn't added to the scene through it, feeding it
+ * scripted intents:
+ *
+ * - free_fall: dropped onto a flat floor
+ * - slope_roll: rolling down a 45 degree ramp
+ * - dash_spam: dashing back and forth along a floor
+ * - wall_bounce: thrown fast around a closed room
+ * - ceiling_jump: jumping under a ceiling lower than the expanded blob
+ *
+ * The first pass steps a blob_reference, the frozen baseline physics in
+ * reference.cpp, alongside the blob and samples both trajectories. The blob
+ * has to stay within BLOB_BENCH_TOLERANCE pixels of the reference, and of
+ * its golden copy in golden.cpp if one has been recorded. When record is set
+ * the trajectory is printed in golden.cpp's format instead. The second pass
+ * steps BLOB_BENCH_COPIES blobs through the same scenario and reports blobs
+ * stepped per second and the tile rays requested and actually cast per blob
+ * step. Accept a physics change only if every scenario still matches and
+ * the throughput doesn't drop.
+ */
+class blob_bench {
+  scene@ g;
+  array<blob_scenario@> scenarios;
+  array<blob_golden@> goldens;
+  int mismatches;
+  int ramp_shape; /* Shape index of BLOB_BENCH_RAMP, -1 until found */
+
+  blob_bench() {
+    @g = @get_scene();
+    load_blob_goldens(@goldens);
+    mismatches = 0;
+    ramp_shape = -1;
+
+    blob_scenario@ sc;
+    @sc = blob_scenario("free_fall", 16 * 48, 4 * 48, 0, 0,
+                        @blob_input_none);
+    sc.add_floor();
+    scenarios.insertLast(@sc);
+
+    @sc = blob_scenario("slope_roll", 20 * 48, 3 * 48, 0, 0,
+                        @blob_input_roll_left);
+    sc.add_floor();
+    for (int i = 0; i < 14; i++) {
+      sc.fill(4 + i, BLOB_BENCH_H - 2 - i, 4 + i, BLOB_BENCH_H - 2 - i,
+              BLOB_BENCH_RAMP);
+      sc.fill(4 + i, BLOB_BENCH_H - 1 - i, 4 + i, BLOB_BENCH_H - 2);
+    }
+    sc.fill(18, 5, BLOB_BENCH_W - 1, BLOB_BENCH_H - 2);
+    scenarios.insertLast(@sc);
+
+    @sc = blob_scenario("dash_spam", 16 * 48, (BLOB_BENCH_H - 2) * 48, 0, 0,
+                        @blob_input_dash_spam);
+    sc.add_floor();
+    sc.fill(0, 0, 0, BLOB_BENCH_H - 1);
+    sc.fill(BLOB_BENCH_W - 1, 0, BLOB_BENCH_W - 1, BLOB_BENCH_H - 1);
+    scenarios.insertLast(@sc);
+
+    @sc = blob_scenario("wall_bounce", 16 * 48, 10 * 48, 3000, -1200,
+                        @blob_input_none);
+    sc.add_floor();
+    sc.fill(0, 0, BLOB_BENCH_W - 1, 0);
+    sc.fill(0, 0, 0, BLOB_BENCH_H - 1);
+    sc.fill(BLOB_BENCH_W - 1, 0, BLOB_BENCH_W - 1, BLOB_BENCH_H - 1);
+    scenarios.insertLast(@sc);
+
+    /* Two tiles of headroom; a fully expanded blob is over two tiles tall. */
+    @sc = blob_scenario("ceiling_jump", 16 * 48, (BLOB_BENCH_H - 2) * 48, 0, 0,
+                        @blob_input_jump_spam);
+    sc.add_floor();
+    sc.fill(0, BLOB_BENCH_H - 4, BLOB_BENCH_W - 1, BLOB_BENCH_H - 4);
+    scenarios.insertLast(@sc);
+  }
+
+  /* Returns the number of scenarios that differ from the reference or their
+   * golden, or -1 if the bench area isn't empty. */
+  int run_all(bool record = false) {
+    if (!area_clear()) {
+      puts("blob_bench: tiles found at (" + BLOB_BENCH_TX + ", " +
+           BLOB_BENCH_TY + "), refusing to overwrite them");
+      return -1;
+    }
+
+    /* Keep benchmark blobs out of the replay desync hash. */
+    desync_sink@ saved_hash = @desync_hash;
+    @desync_hash = null;
+
+    mismatches = 0;
+    ramp_shape = find_ramp();
+    for (uint i = 0; i < scenarios.size(); i++) {
+      run(@scenarios[i], record);
+    }
+
+    @desync_hash = @saved_hash;
+    if (!record) {
+      puts("blob_bench: " + mismatches + "/" + scenarios.size() +
+           " scenarios differ from the reference or their golden");
+    }
+    return mismatches;
+  }
+
+  bool area_clear() {
+    for (int ty = 0; ty < BLOB_BENCH_H; ty++) {
+      for (int tx = 0; tx < BLOB_BENCH_W; tx++) {
+        tileinfo@ ti = @g.get_tile(BLOB_BENCH_TX + tx, BLOB_BENCH_TY + ty, 19);
+        if (@ti != null && ti.solid()) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  /* Returns the shape whose top, hit by a ray straight down the middle of
+   * the tile, is a 45 degree slope rising to the right halfway down, or -1.
+   * Probes a single tile of the (empty) bench area. */
+  int find_ramp() {
+    int tx = BLOB_BENCH_TX + 1;
+    int ty = BLOB_BENCH_TY + 1;
+    float x = (tx + 0.5) * TILE_PIXELS;
+    float y = ty * TILE_PIXELS;
+    int found = -1;
+    for (int shape = 1; shape < BLOB_BENCH_SHAPES && found == -1; shape++) {
+      g.set_tile(tx, ty, 19, true, shape, 1, 1, 1);
+      raycast@ rc = @g.ray_cast_tiles(x, y - TILE_PIXELS, x, y + TILE_PIXELS);
+      float ang = rc.hit() ? rc.angle() : 0;
+      if (ang > 180) {
+        ang -= 360;
+      }
+      if (rc.hit() && abs(ang + 45) < 1 &&
+          abs(rc.hit_y() - (y + TILE_PIXELS / 2)) < 1) {
+        found = shape;
+      }
+    }
+    g.set_tile(tx, ty, 19, false, 0, 0, 0, 0);
+    if (found == -1) {
+      puts("blob_bench: no 45 degree ramp shape found, slope_roll can't run");
+    }
+    return found;
+  }
+
+  void run(blob_scenario@ sc, bool record) {
+    if (!can_build(@sc)) {
+      mismatches++;
+      return;
+    }
+    build(@sc, true);
+    trajectory(@sc, record);
+    throughput(@sc);
+    build(@sc, false);
+  }
+
+  bool can_build(blob_scenario@ sc) {
+    for (uint i = 0; i < sc.rects.size(); i += 5) {
+      if (sc.rects[i + 4] == BLOB_BENCH_RAMP && ramp_shape == -1) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void build(blob_scenario@ sc, bool solid) {
+    for (uint i = 0; i < sc.rects.size(); i += 5) {
+      int shape = sc.rects[i + 4] == BLOB_BENCH_RAMP ? ramp_shape :
+                  sc.rects[i + 4];
+      for (int ty = sc.rects[i + 1]; ty <= sc.rects[i + 3]; ty++) {
+        for (int tx = sc.rects[i]; tx <= sc.rects[i + 2]; tx++) {
+          g.set_tile(BLOB_BENCH_TX + tx, BLOB_BENCH_TY + ty, 19, solid,
+                     solid ? shape : 0, solid ? 1 : 0,
+                     solid ? 1 : 0, solid ? 1 : 0);
+        }
+      }
+    }
+  }
+
+  blob@ spawn(blob_scenario@ sc) {
+    float x = BLOB_BENCH_TX * TILE_PIXELS + sc.x;
+    float y = BLOB_BENCH_TY * TILE_PIXELS + sc.y;
+    blob@ b = blob();
+    scriptenemy@ se = create_scriptenemy(@b);
+    se.x(x);
+    se.y(y);
+    se.set_speed_xy(sc.x_speed, sc.y_speed);
+    b.init(null, se);
+    b.prev_x = x;
+    b.prev_y = y;
+    return b;
+  }
+
+  blob_reference@ spawn_reference(blob_scenario@ sc) {
+    blob_reference@ r = blob_reference();
+    scriptenemy@ se = create_scriptenemy(@r);
+    se.x(BLOB_BENCH_TX * TILE_PIXELS + sc.x);
+    se.y(BLOB_BENCH_TY * TILE_PIXELS + sc.y);
+    se.set_speed_xy(sc.x_speed, sc.y_speed);
+    r.init(null, se);
+    return r;
+  }
+
+  void sample(scriptenemy@ se, array<float>@ samples) {
+    samples.insertLast(se.x() - BLOB_BENCH_TX * TILE_PIXELS);
+    samples.insertLast(se.y() - BLOB_BENCH_TY * TILE_PIXELS);
+  }
+
+  void trajectory(blob_scenario@ sc, bool record) {
+    blob@ b = spawn(@sc);
+    blob_reference@ r = spawn_reference(@sc);
+    array<float> samples;
+    array<float> reference;
+    for (int frame = 0; frame < BLOB_BENCH_FRAMES; frame++) {
+      sc.input(@b.self, frame);
+      b.step();
+      sc.input(@r.self, frame);
+      r.step();
+      if (frame % BLOB_BENCH_SAMPLE == 0) {
+        sample(@b.self, @samples);
+        sample(@r.self, @reference);
+      }
+    }
+
+    if (record) {
+      string list = "";
+      for (uint i = 0; i < samples.size(); i++) {
+        list += (i == 0 ? "" : ", ") + samples[i];
+      }
+      puts("  {\n    array<float> samples = {" + list + "};\n" +
+           "    goldens.insertLast(blob_golden(\"" + sc.name +
+           "\", samples));\n  }");
+      return;
+    }
+
+    bool same = compare(sc.name, "reference", @samples, @reference);
+    blob_golden@ golden = find_golden(sc.name);
+    if (@golden != null) {
+      same = compare(sc.name, "golden", @samples, @golden.samples) && same;
+    }
+    if (!same) {
+      mismatches++;
+    }
+  }
+
+  /* Prints and returns whether samples stay within BLOB_BENCH_TOLERANCE of
+   * expected. */
+  bool compare(const string &in name, const string &in what,
+               array<float>@ samples, array<float>@ expected) {
+    float worst = 0;
+    int worst_frame = 0;
+    bool same = expected.size() == samples.size();
+    for (uint i = 0; same && i < samples.size(); i++) {
+      float d = abs(samples[i] - expected[i]);
+      if (d > worst) {
+        worst = d;
+        worst_frame = (i / 2) * BLOB_BENCH_SAMPLE;
+      }
+    }
+    same = same && worst <= BLOB_BENCH_TOLERANCE;
+    puts(name + ": " + (same ? "matches" : "DIFFERS from") + " " + what +
+         ", worst deviation " + worst + "px at frame " + worst_frame);
+    return same;
+  }
+
+  void throughput(blob_scenario@ sc) {
+    array<blob@> blobs(BLOB_BENCH_COPIES);
+    for (int i = 0; i < BLOB_BENCH_COPIES; i++) {
+      @blobs[i] = spawn(@sc);
+    }
+
+    int64 t0 = get_time_us();
+    for (int frame = 0; frame < BLOB_BENCH_FRAMES; frame++) {
+      for (int i = 0; i < BLOB_BENCH_COPIES; i++) {
+        sc.input(@blobs[i].self, frame);
+        blobs[i].step();
+      }
+    }
+    int elapsed = max(1, int(get_time_us() - t0));
+
+    uint requested = 0;
+    uint cast = 0;
+    for (int i = 0; i < BLOB_BENCH_COPIES; i++) {
+      requested += blobs[i].rays.requested;
+      cast += blobs[i].rays.cast_count;
+    }
+    float steps = float(BLOB_BENCH_COPIES) * BLOB_BENCH_FRAMES;
+    puts("  " + BLOB_BENCH_COPIES + " blobs x " + BLOB_BENCH_FRAMES +
+         " frames in " + elapsed + "us: " +
+         int(steps * 1000000.0 / elapsed) + " blob steps/s, " +
+         requested / steps + " rays requested and " + cast / steps +
+         " cast per step");
+  }
+
+  blob_golden@ find_golden(const string &in name) {
+    for (uint i = 0; i < goldens.size(); i++) {
+      if (goldens[i].name == name) {
+        return goldens[i];
+      }
+    }
+    return null;
+  }
+}
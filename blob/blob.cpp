@@ -1,5 +1,9 @@
 #include "spritegroup.cpp"
-#include "math.cpp"
+#include "../utils/math.cpp"
+#include "../utils/desync_hash.cpp"
+#include "../utils/ray_batch.cpp"
+#include "../utils/time_coeffs.cpp"
+#include "../utils/controller_cache.cpp"
 
 const int BLOB_MAX_BOUNCES = 5;
 const int BLOB_COLLISION_CHECKS = 7;
@@ -14,6 +18,25 @@ const float BLOB_BOUNCE_DI_FORCE = 200;
 const float BLOB_AIR_FRICTION = 0.85; /* Decay/s */
 const float BLOB_AIR_FRICTION_DI_COEFF = 0.4;
 
+/* Slots in blob::coeffs */
+enum blob_coeff {
+  blob_coeff_frame = 0, /* inc(1) */
+  blob_coeff_light_attack, /* inc(3) */
+  blob_coeff_heavy_attack, /* inc(8) */
+  blob_coeff_state_time, /* inc(11.95) */
+  blob_coeff_jump_phase, /* inc(4) */
+  blob_coeff_ticks, /* inc(24) */
+  blob_coeff_spin, /* inc(1000) */
+  blob_coeff_gravity, /* s_inc(gravity) */
+  blob_coeff_radius, /* s(BLOB_BASE_RADIUS) */
+  blob_coeff_bounce_di, /* s(BLOB_BOUNCE_DI_FORCE) */
+  blob_coeff_stick_speed, /* s(BLOB_STICK_SPEED_THRESH) */
+  blob_coeff_air_friction, /* pow(BLOB_AIR_FRICTION, inc(1)) */
+}
+
+/* Which entity each player controls, shared by every blob and the script */
+controller_cache controllers;
+
 enum blob_state {
   blob_state_roll = 0,
   blob_state_dash = 1,
@@ -55,15 +78,32 @@ class blob : enemy_base, callback_base {
   float prev_x;
   float prev_y;
 
+  ray_batch@ rays;
+  time_coeffs coeffs;
+
   array<tile_clean_data> clean_tiles;
 
   blob() {
     @g = get_scene();
+    @rays = ray_batch(BLOB_COLLISION_CHECKS);
     spr.add_sprite("beachball", "beachball");
 
     gravity = 1500;
     angular_momentum = 0;
     state = 0;
+
+    coeffs.set(blob_coeff_frame, COEFF_INC, 1);
+    coeffs.set(blob_coeff_light_attack, COEFF_INC, 3);
+    coeffs.set(blob_coeff_heavy_attack, COEFF_INC, 8);
+    coeffs.set(blob_coeff_state_time, COEFF_INC, 11.95);
+    coeffs.set(blob_coeff_jump_phase, COEFF_INC, 4);
+    coeffs.set(blob_coeff_ticks, COEFF_INC, 24);
+    coeffs.set(blob_coeff_spin, COEFF_INC, 1000);
+    coeffs.set(blob_coeff_gravity, COEFF_S_INC, gravity);
+    coeffs.set(blob_coeff_radius, COEFF_S, BLOB_BASE_RADIUS);
+    coeffs.set(blob_coeff_bounce_di, COEFF_S, BLOB_BOUNCE_DI_FORCE);
+    coeffs.set(blob_coeff_stick_speed, COEFF_S, BLOB_STICK_SPEED_THRESH);
+    coeffs.set(blob_coeff_air_friction, COEFF_POW_INC, BLOB_AIR_FRICTION);
   }
 
   void init(script@ sc, scriptenemy@ self) {
@@ -73,6 +113,9 @@ class blob : enemy_base, callback_base {
     prev_x = self.x();
     prev_y = self.y();
 
+    /* gravity may still change once the entity's properties are loaded. */
+    coeffs.set(blob_coeff_gravity, COEFF_S_INC, gravity);
+
     self.auto_physics(false);
     self.on_hit_callback(@this, "on_hit", 0);
     self.on_hurt_callback(@this, "on_hurt", 0);
@@ -102,23 +145,12 @@ class blob : enemy_base, callback_base {
     break_combo();
   }
 
-  float inc(float x) {
-    return x / 60.0 * self.time_warp();
-  }
-
-  float s(float x) {
-    return x * self.scale();
-  }
-
-  float s_inc(float x) {
-    return s(inc(x));
-  }
-
   void state_roll() {
     if (@attack_hitbox == null &&
         0 < self.light_intent() && self.light_intent() <= 10) {
       self.light_intent(11);
-      @attack_hitbox = create_hitbox(@self.as_controllable(), inc(3),
+      @attack_hitbox = create_hitbox(@self.as_controllable(),
+            coeffs.get(blob_coeff_light_attack),
             self.x(), self.y(), -1, 1, -1, 1);
       attack_hitbox.damage(1);
       attack_hitbox.aoe(true);
@@ -128,7 +160,8 @@ class blob : enemy_base, callback_base {
     if (@attack_hitbox == null &&
         0 < self.heavy_intent() && self.heavy_intent() <= 10) {
       self.heavy_intent(11);
-      @attack_hitbox = create_hitbox(@self.as_controllable(), inc(8),
+      @attack_hitbox = create_hitbox(@self.as_controllable(),
+            coeffs.get(blob_coeff_heavy_attack),
             self.x(), self.y(), -1, 1, -1, 1);
       attack_hitbox.damage(3);
       attack_hitbox.aoe(true);
@@ -150,14 +183,14 @@ class blob : enemy_base, callback_base {
       angular_momentum = max(angular_momentum, BLOB_DASH_ANGULAR_SPEED);
     }
 
-    if (state_timer > inc(11.95)) {
+    if (state_timer > coeffs.get(blob_coeff_state_time)) {
       state = blob_state_roll;
       state_timer = 0;
     }
   }
 
   void state_jump() {
-    if (state_timer > inc(11.95)) {
+    if (state_timer > coeffs.get(blob_coeff_state_time)) {
       state = blob_state_roll;
       state_timer = 0;
     }
@@ -187,7 +220,7 @@ class blob : enemy_base, callback_base {
 
   float radius_multiplier() {
     if (state == blob_state_jump) {
-      float per = state_timer / inc(4);
+      float per = state_timer / coeffs.get(blob_coeff_jump_phase);
       if (per < 1) {
         return 1 + per;
       } else if (per < 2) {
@@ -201,26 +234,28 @@ class blob : enemy_base, callback_base {
 
   float jump_force() {
     if (state == blob_state_jump) {
-      float per = state_timer / inc(4);
+      float phase = coeffs.get(blob_coeff_jump_phase);
+      float per = state_timer / phase;
       if (per < 1) {
-        return s(BLOB_BASE_RADIUS) / inc(4);
+        return coeffs.get(blob_coeff_radius) / phase;
       } else if (per < 2) {
         return 0;
       } else {
-        return -s(BLOB_BASE_RADIUS) / inc(4) / 2;
+        return -coeffs.get(blob_coeff_radius) / phase / 2;
       }
     }
     return 0;
   }
 
   float calc_radius() {
-    return s(BLOB_BASE_RADIUS) * radius_multiplier();
+    return coeffs.get(blob_coeff_radius) * radius_multiplier();
   }
 
   void step() {
+    coeffs.update(self.time_warp(), self.scale());
     float ff = self.freeze_frame_timer();
     if (ff > 0) {
-      self.freeze_frame_timer(ff - inc(24));
+      self.freeze_frame_timer(ff - coeffs.get(blob_coeff_ticks));
       return;
     }
 
@@ -232,7 +267,7 @@ class blob : enemy_base, callback_base {
     float radius = calc_radius();
     int yintent = self.y_intent();
 
-    angular_momentum += inc(1000.0 * self.x_intent());
+    angular_momentum += self.x_intent() * coeffs.get(blob_coeff_spin);
     angular_momentum = min(BLOB_MAX_ANGULAR_MOMENTUM, angular_momentum);
     angular_momentum = max(-BLOB_MAX_ANGULAR_MOMENTUM, angular_momentum);
 
@@ -244,27 +279,31 @@ class blob : enemy_base, callback_base {
     } else if (state == blob_state_jump) {
       state_jump();
     }
-    state_timer += inc(1.0);
+    state_timer += coeffs.get(blob_coeff_frame);
 
-    y_speed += s_inc(gravity);
+    y_speed += coeffs.get(blob_coeff_gravity);
     self.set_speed_xy(x_speed, y_speed);
 
-    float tm = inc(1.0);
+    float tm = coeffs.get(blob_coeff_frame);
     for (int bounces = 0; bounces < BLOB_MAX_BOUNCES && tm > 1e-9; bounces++) {
       float speed = self.speed();
       float dir = self.direction();
 
-      /* Clip our position backwards if needed. */
+      /* Clip our position backwards if needed. Rays after a correction start
+       * from the corrected position and are cast again. */
+      rays.fan(x, y, radius, dir, BLOB_COLLISION_CHECKS);
+      bool moved = false;
       for (int i = 0; i < BLOB_COLLISION_CHECKS; i++) {
-        float edge_dir =
-            dir + 180.0 * (i + 1) / (BLOB_COLLISION_CHECKS + 1) - 90;
-        raycast@ rc = g.ray_cast_tiles(x, y,
-            x + lengthdir_x(radius, edge_dir),
-            y + lengthdir_y(radius, edge_dir));
-        if (rc.hit()) {
-          float dst = radius - distance(x, y, rc.hit_x(), rc.hit_y());
-          x += lengthdir_x(dst, rc.angle());
-          y += lengthdir_y(dst, rc.angle());
+        if (moved) {
+          float edge_dir = rays.ray_dir(i);
+          rays.cast(i, x, y, x + lengthdir_x(radius, edge_dir),
+                    y + lengthdir_y(radius, edge_dir));
+        }
+        if (rays.hit(i)) {
+          float dst = radius - distance(x, y, rays.hit_x(i), rays.hit_y(i));
+          x += lengthdir_x(dst, rays.angle(i));
+          y += lengthdir_y(dst, rays.angle(i));
+          moved = true;
         }
       }
 
@@ -274,25 +313,26 @@ class blob : enemy_base, callback_base {
       bool found_collision = false;
       float collision_tm = tm;
       float collision_dir = 0;
+      rays.sweep(x, y, radius, dir, BLOB_COLLISION_CHECKS, dx, dy);
       for (int i = 0; i < BLOB_COLLISION_CHECKS; i++) {
-        float edge_dir =
-            dir + 180.0 * (i + 1) / (BLOB_COLLISION_CHECKS + 1) - 90;
-
-        float edge_x = x + lengthdir_x(radius, edge_dir);
-        float edge_y = y + lengthdir_y(radius, edge_dir);
-        raycast@ rc = g.ray_cast_tiles(edge_x, edge_y,
-                                       edge_x + dx, edge_y + dy);
-        if (rc.hit()) {
-          float tm = distance(edge_x, edge_y, rc.hit_x(), rc.hit_y()) / speed;
+        if (rays.hit(i)) {
+          float edge_x = x + lengthdir_x(radius, rays.ray_dir(i));
+          float edge_y = y + lengthdir_y(radius, rays.ray_dir(i));
+          float tm = distance(edge_x, edge_y, rays.hit_x(i), rays.hit_y(i)) /
+                     speed;
           if  (tm < collision_tm) {
             found_collision = true;
             collision_tm = tm;
-            collision_dir = rc.angle();
+            collision_dir = rays.angle(i);
 
-            int tx = rc.tile_x();
-            int ty = rc.tile_y();
+            int tx = rays.tile_x(i);
+            int ty = rays.tile_y(i);
             tileinfo@ ti = g.get_tile(tx, ty, 19);
             if (ti.is_dustblock()) {
+              if (@desync_hash != null) {
+                desync_hash.add(tx);
+                desync_hash.add(ty);
+              }
               ti.sprite_tile(0);
               g.set_tile(tx, ty, 19, @ti, true);
               clean_tiles.insertLast(tile_clean_data(tx, ty, 5.0));
@@ -312,9 +352,9 @@ class blob : enemy_base, callback_base {
 
         float bounce_di = 0;
         if (dy < 0 && yintent == 1) {
-          bounce_di = s(BLOB_BOUNCE_DI_FORCE);
+          bounce_di = coeffs.get(blob_coeff_bounce_di);
         }
-        if (abs(dt) < s(BLOB_STICK_SPEED_THRESH) + bounce_di) {
+        if (abs(dt) < coeffs.get(blob_coeff_stick_speed) + bounce_di) {
           x_speed -= dt * dx;
           y_speed -= dt * dy;
         } else {
@@ -360,12 +400,12 @@ class blob : enemy_base, callback_base {
 
     self.set_xy(x, y);
 
-    float fric = pow(BLOB_AIR_FRICTION, inc(1));
+    float fric = coeffs.get(blob_coeff_air_friction);
     x_speed *= fric;
     y_speed *= fric;
 
     float ang_diff = angular_momentum;
-    angular_momentum *= pow(BLOB_AIR_FRICTION, inc(1));
+    angular_momentum *= coeffs.get_double(blob_coeff_air_friction);
     ang_diff = angular_momentum - ang_diff;
 
     float air_force = ang_diff * BLOB_AIR_FRICTION_DI_COEFF;
@@ -374,6 +414,15 @@ class blob : enemy_base, callback_base {
     y_speed += lengthdir_y(air_force, air_force_dir);
     self.set_speed_xy(x_speed, y_speed);
 
+    if (@desync_hash != null) {
+      desync_hash.add(x);
+      desync_hash.add(y);
+      desync_hash.add(x_speed);
+      desync_hash.add(y_speed);
+      desync_hash.add(angular_momentum);
+      desync_hash.add(state);
+    }
+
     self.rotation(rotation);
     self.hit_rectangle(-radius, radius, -radius, radius);
     self.base_rectangle(-radius, radius, -radius, radius);
@@ -391,7 +440,7 @@ class blob : enemy_base, callback_base {
     }
 
     for (int i = 0; i < clean_tiles.size(); i++) {
-      clean_tiles[i].timer -= inc(24);
+      clean_tiles[i].timer -= coeffs.get(blob_coeff_ticks);
       if (clean_tiles[i].timer <= 0) {
         g.set_tile(clean_tiles[i].x, clean_tiles[i].y, 19, false, 0, 0, 0, 0);
         clean_tiles[i] = clean_tiles[clean_tiles.size() - 1];
@@ -405,6 +454,7 @@ class blob : enemy_base, callback_base {
   }
 
   void draw(float subframe) {
+    coeffs.update(self.time_warp(), self.scale());
     float x = lerp(prev_x, self.x(), subframe);
     float y = lerp(prev_y, self.y(), subframe);
     float scale = self.scale();
@@ -432,14 +482,7 @@ class blob : enemy_base, callback_base {
   }
 
   void break_combo() {
-    bool found = false;
-    for (int i = 0; i < num_cameras(); i++) {
-      if (self.is_same(controller_entity(i))) {
-        found = true;
-        break;
-      }
-    }
-    if (found) {
+    if (controllers.player_of(@self.as_entity()) != -1) {
       g.combo_break_count(g.combo_break_count() + 1);
     }
   }
@@ -0,0 +1,22 @@
+class blob_golden {
+  /* Recorded trajectory of one blob_bench scenario: the blob's position
+   * relative to the scenario map every BLOB_BENCH_SAMPLE frames, as x, y
+   * pairs. */
+  string name;
+  array<float> samples;
+
+  blob_golden(const string &in name, const array<float> &in samples) {
+    this.name = name;
+    this.samples = samples;
+  }
+}
+
+/* Golden trajectories blob_bench checks against on top of blob_reference.
+ * A run with record_golden set prints a block per scenario; paste them here
+ * to pin the trajectories down against engine changes as well. Scenarios
+ * without a golden are only checked against the reference.
+ *
+ * None have been recorded yet; recording needs the game.
+ */
+void load_blob_goldens(array<blob_golden@>@ goldens) {
+}
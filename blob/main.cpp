@@ -1,10 +1,46 @@
 #include "blob.cpp"
+#include "bench.cpp"
+#include "../utils/desync_detector.cpp"
+#include "../utils/replay_channel_test.cpp"
 
 class script {
   scene@ g;
+  desync_detector@ detector;
+
+  [check] bool desync_check; /* Record and verify replay desync hashes */
+  [check] bool benchmark; /* Run the blob physics scenarios on level start */
+  [check] bool record_golden; /* Print trajectories instead of checking them */
+  [check] bool channel_test; /* Test desync packet loss recovery on start */
+  bool benchmark_done;
 
   script() {
     @g = get_scene();
+    desync_check = false;
+    benchmark = false;
+    record_golden = false;
+    channel_test = false;
+    benchmark_done = false;
+  }
+
+  void step(int) {
+    if (desync_check && @detector == null) {
+      @detector = desync_detector();
+      @desync_hash = @detector;
+    }
+    if (@detector != null) {
+      detector.step();
+    }
+
+    if ((benchmark || channel_test) && !benchmark_done) {
+      benchmark_done = true;
+      if (channel_test) {
+        replay_channel_test();
+      }
+      if (benchmark) {
+        blob_bench bench;
+        bench.run_all(record_golden);
+      }
+    }
   }
 
   void spawn_player(message@ msg) {
@@ -23,19 +59,19 @@ class script {
   }
 
   void entity_on_remove(entity@ e) {
-    for (int i = 0; i < num_cameras(); i++) {
-      if (controller_controllable(i).is_same(@e)) {
-        if (num_cameras() > 1) {
-          scriptenemy@ se = create_scriptenemy(blob_respawner(i, 1.0));
-          se.x(g.get_checkpoint_x(i));
-          se.y(g.get_checkpoint_y(i));
-          controller_entity(i, @se.as_controllable());
-          g.add_entity(@se.as_entity(), false);
-        } else {
-          g.combo_break_count(g.combo_break_count() + 1);
-          g.load_checkpoint();
-        }
-      }
+    int i = controllers.player_of(@e);
+    if (i == -1) {
+      return;
+    }
+    if (num_cameras() > 1) {
+      scriptenemy@ se = create_scriptenemy(blob_respawner(i, 1.0));
+      se.x(g.get_checkpoint_x(i));
+      se.y(g.get_checkpoint_y(i));
+      g.add_entity(@se.as_entity(), false);
+      controllers.set(i, @se.as_controllable());
+    } else {
+      g.combo_break_count(g.combo_break_count() + 1);
+      g.load_checkpoint();
     }
   }
 }
@@ -73,7 +109,7 @@ class blob_respawner : enemy_base {
       b.prev_x = x;
       b.prev_y = y;
       g.add_entity(@se.as_entity(), false);
-      controller_entity(player, @se.as_controllable());
+      controllers.set(player, @se.as_controllable());
 
       g.remove_entity(@self.as_entity());
     }
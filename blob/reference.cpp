@@ -0,0 +1,276 @@
+#include "blob.cpp"
+
+/* Usage:
+ *
+ * blob_reference is a frozen copy of blob's movement physics as it was before
+ * any of the ray batching and time warp caching, kept for blob_bench to step
+ * next to the live blob. Don't change it along with blob.cpp; it is the
+ * reference those changes are checked against.
+ *
+ * Only what moves the blob is kept. Attacks, the player collision, filth and
+ * dustblock cleaning are left out; the bench scenarios never attack and their
+ * maps have no dustblocks.
+ */
+class blob_reference : enemy_base {
+  scene@ g;
+  scriptenemy@ self;
+
+  float gravity;
+  float angular_momentum;
+  int state;
+  float state_timer;
+
+  blob_reference() {
+    @g = get_scene();
+    gravity = 1500;
+    angular_momentum = 0;
+    state = 0;
+    state_timer = 0;
+  }
+
+  void init(script@ sc, scriptenemy@ self) {
+    @this.self = @self;
+    self.auto_physics(false);
+  }
+
+  float inc(float x) {
+    return x / 60.0 * self.time_warp();
+  }
+
+  float s(float x) {
+    return x * self.scale();
+  }
+
+  float s_inc(float x) {
+    return s(inc(x));
+  }
+
+  void state_roll() {
+    can_dash();
+    can_jump();
+  }
+
+  void state_dash() {
+    int dir = state_timer == 0 ? self.x_intent() : 0;
+    if (dir == 0) {
+      dir = sgn(angular_momentum);
+    }
+    if (dir == -1) {
+      angular_momentum = min(angular_momentum, -BLOB_DASH_ANGULAR_SPEED);
+    } else if (dir == 1) {
+      angular_momentum = max(angular_momentum, BLOB_DASH_ANGULAR_SPEED);
+    }
+
+    if (state_timer > inc(11.95)) {
+      state = blob_state_roll;
+      state_timer = 0;
+    }
+  }
+
+  void state_jump() {
+    if (state_timer > inc(11.95)) {
+      state = blob_state_roll;
+      state_timer = 0;
+    }
+  }
+
+  bool can_dash() {
+    if (self.dash_intent() == 1 ||
+        self.fall_intent() == 1) {
+      self.dash_intent(2);
+      self.fall_intent(2);
+      state = blob_state_dash;
+      state_timer = 0;
+      return true;
+    }
+    return false;
+  }
+
+  bool can_jump() {
+    if (self.jump_intent() == 1) {
+      self.jump_intent(2);
+      state = blob_state_jump;
+      state_timer = 0;
+      return true;
+    }
+    return false;
+  }
+
+  float radius_multiplier() {
+    if (state == blob_state_jump) {
+      float per = state_timer / inc(4);
+      if (per < 1) {
+        return 1 + per;
+      } else if (per < 2) {
+        return 2;
+      } else {
+        return 2 - (per - 2) / 2.0;
+      }
+    }
+    return 1;
+  }
+
+  float jump_force() {
+    if (state == blob_state_jump) {
+      float per = state_timer / inc(4);
+      if (per < 1) {
+        return s(BLOB_BASE_RADIUS) / inc(4);
+      } else if (per < 2) {
+        return 0;
+      } else {
+        return -s(BLOB_BASE_RADIUS) / inc(4) / 2;
+      }
+    }
+    return 0;
+  }
+
+  float calc_radius() {
+    return s(BLOB_BASE_RADIUS) * radius_multiplier();
+  }
+
+  void step() {
+    float ff = self.freeze_frame_timer();
+    if (ff > 0) {
+      self.freeze_frame_timer(ff - inc(24));
+      return;
+    }
+
+    float x = self.x();
+    float y = self.y();
+    float rotation = self.rotation();
+    float x_speed = self.x_speed();
+    float y_speed = self.y_speed();
+    float radius = calc_radius();
+    int yintent = self.y_intent();
+
+    angular_momentum += inc(1000.0 * self.x_intent());
+    angular_momentum = min(BLOB_MAX_ANGULAR_MOMENTUM, angular_momentum);
+    angular_momentum = max(-BLOB_MAX_ANGULAR_MOMENTUM, angular_momentum);
+
+    if (state == blob_state_roll) {
+      state_roll();
+    }
+    if (state == blob_state_dash) {
+      state_dash();
+    } else if (state == blob_state_jump) {
+      state_jump();
+    }
+    state_timer += inc(1.0);
+
+    y_speed += s_inc(gravity);
+    self.set_speed_xy(x_speed, y_speed);
+
+    float tm = inc(1.0);
+    for (int bounces = 0; bounces < BLOB_MAX_BOUNCES && tm > 1e-9; bounces++) {
+      float speed = self.speed();
+      float dir = self.direction();
+
+      /* Clip our position backwards if needed. */
+      for (int i = 0; i < BLOB_COLLISION_CHECKS; i++) {
+        float edge_dir =
+            dir + 180.0 * (i + 1) / (BLOB_COLLISION_CHECKS + 1) - 90;
+        raycast@ rc = g.ray_cast_tiles(x, y,
+            x + lengthdir_x(radius, edge_dir),
+            y + lengthdir_y(radius, edge_dir));
+        if (rc.hit()) {
+          float dst = radius - distance(x, y, rc.hit_x(), rc.hit_y());
+          x += lengthdir_x(dst, rc.angle());
+          y += lengthdir_y(dst, rc.angle());
+        }
+      }
+
+      float dx = lengthdir_x(tm * speed, dir);
+      float dy = lengthdir_y(tm * speed, dir);
+
+      bool found_collision = false;
+      float collision_tm = tm;
+      float collision_dir = 0;
+      for (int i = 0; i < BLOB_COLLISION_CHECKS; i++) {
+        float edge_dir =
+            dir + 180.0 * (i + 1) / (BLOB_COLLISION_CHECKS + 1) - 90;
+
+        float edge_x = x + lengthdir_x(radius, edge_dir);
+        float edge_y = y + lengthdir_y(radius, edge_dir);
+        raycast@ rc = g.ray_cast_tiles(edge_x, edge_y,
+                                       edge_x + dx, edge_y + dy);
+        if (rc.hit()) {
+          float tm = distance(edge_x, edge_y, rc.hit_x(), rc.hit_y()) / speed;
+          if  (tm < collision_tm) {
+            found_collision = true;
+            collision_tm = tm;
+            collision_dir = rc.angle();
+          }
+        }
+      }
+      if (found_collision) {
+        x += collision_tm * x_speed;
+        y += collision_tm * y_speed;
+        rotation += collision_tm * angular_momentum;
+
+        /* Apply perpendicular force from collision. */
+        float dx = lengthdir_x(1.0, collision_dir);
+        float dy = lengthdir_y(1.0, collision_dir);
+        float dt = x_speed * dx + y_speed * dy;
+
+        float bounce_di = 0;
+        if (dy < 0 && yintent == 1) {
+          bounce_di = s(BLOB_BOUNCE_DI_FORCE);
+        }
+        if (abs(dt) < s(BLOB_STICK_SPEED_THRESH) + bounce_di) {
+          x_speed -= dt * dx;
+          y_speed -= dt * dy;
+        } else {
+          x_speed -= (1.0 + BLOB_BOUNCE_EFFICIENCY) * dt * dx;
+          y_speed -= (1.0 + BLOB_BOUNCE_EFFICIENCY) * dt * dy;
+          x_speed -= bounce_di * dx;
+          y_speed -= bounce_di * dy;
+        }
+
+        float jf = jump_force();
+        x_speed += jf * dx;
+        y_speed += jf * dy;
+
+        /* Apply parallel force from angular momentum. */
+        dx = lengthdir_x(1.0, collision_dir + 90);
+        dy = lengthdir_y(1.0, collision_dir + 90);
+        dt = x_speed * dx + y_speed * dy;
+
+        float speed_diff = degtorad(angular_momentum) * radius - dt;
+        x_speed += speed_diff * BLOB_BOUNCE_ANGULAR_FRICTION * dx;
+        y_speed += speed_diff * BLOB_BOUNCE_ANGULAR_FRICTION * dy;
+        angular_momentum -= speed_diff * BLOB_BOUNCE_ANGULAR_FRICTION;
+
+        tm -= collision_tm;
+        self.set_speed_xy(x_speed, y_speed);
+        angular_momentum = min(BLOB_MAX_ANGULAR_MOMENTUM, angular_momentum);
+        angular_momentum = max(-BLOB_MAX_ANGULAR_MOMENTUM, angular_momentum);
+      } else {
+        x += tm * x_speed;
+        y += tm * y_speed;
+        rotation += collision_tm * angular_momentum;
+        break;
+      }
+    }
+
+    while (rotation < -180) rotation += 360;
+    while (rotation > 180) rotation -= 360;
+
+    self.set_xy(x, y);
+
+    float fric = pow(BLOB_AIR_FRICTION, inc(1));
+    x_speed *= fric;
+    y_speed *= fric;
+
+    float ang_diff = angular_momentum;
+    angular_momentum *= pow(BLOB_AIR_FRICTION, inc(1));
+    ang_diff = angular_momentum - ang_diff;
+
+    float air_force = ang_diff * BLOB_AIR_FRICTION_DI_COEFF;
+    float air_force_dir = point_angle(0, 0, x_speed, y_speed) - 90;
+    x_speed += lengthdir_x(air_force, air_force_dir);
+    y_speed += lengthdir_y(air_force, air_force_dir);
+    self.set_speed_xy(x_speed, y_speed);
+
+    self.rotation(rotation);
+  }
+}
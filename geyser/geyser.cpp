@@ -1,6 +1,23 @@
+#include "../utils/desync_hash.cpp"
+#include "../utils/entity_pool.cpp"
+#include "../utils/ray_batch.cpp"
+
 const int GEYSER_STATE_INACTIVE = 0;
 const int GEYSER_STATE_ACTIVE = 1;
 
+entity@ create_geyser_emitter() {
+  return create_entity("entity_emitter");
+}
+
+/* Emitters shared by every geyser; each one only needs an emitter while it
+ * is erupting. The pool notices on its own when a checkpoint load has
+ * removed its emitters, so scripts including this file have nothing to
+ * clear. */
+entity_pool geyser_emitters(@create_geyser_emitter);
+
+/* Collision types the geyser pushes */
+const array<int> GEYSER_COL_TYPES = {1, 5};
+
 float cos_deg(int deg) {
   return sin_deg(deg + 90);
 }
@@ -45,6 +62,11 @@ class geyser : trigger_base {
 
   entity@ emitter;
 
+  /* Entities overlapping the geyser this step, reused between steps */
+  array<controllable@> col_entities;
+
+  ray_batch@ rays;
+
   float mnx, mxx, mny, mxy;
 
   geyser() {
@@ -67,6 +89,7 @@ class geyser : trigger_base {
     @this.g = @get_scene();
     @this.s = s;
     @this.self = self;
+    @rays = ray_batch(2);
   }
 
   void update_bounds(float cx, float cy) {
@@ -112,9 +135,14 @@ class geyser : trigger_base {
       state = GEYSER_STATE_INACTIVE;
       state_timer = cooldown_time;
       if (@emitter != null) {
-        g.remove_entity(@emitter);
+        geyser_emitters.release(@emitter);
+        @emitter = null;
       }
     }
+    if (@desync_hash != null) {
+      desync_hash.add(state);
+      desync_hash.add(state_timer);
+    }
     if (state == GEYSER_STATE_INACTIVE && state_timer > 0) {
       return;
     }
@@ -123,12 +151,9 @@ class geyser : trigger_base {
     float cy = self.y();
     update_bounds(cx, cy);
 
-    array<int> col_types;
-    col_types.insertLast(1);
-    col_types.insertLast(5);
-    array<controllable@> col_entities;
-    for (uint i = 0; i < col_types.size(); i++) {
-      int nc = g.get_entity_collision(mny, mxy, mnx, mxx, col_types[i]);
+    col_entities.resize(0);
+    for (uint i = 0; i < GEYSER_COL_TYPES.size(); i++) {
+      int nc = g.get_entity_collision(mny, mxy, mnx, mxx, GEYSER_COL_TYPES[i]);
       for (int j = 0; j < nc; j++) {
         col_entities.insertLast(@g.get_entity_collision_index(j).as_controllable());
       }
@@ -167,6 +192,11 @@ class geyser : trigger_base {
         start_geyser();
       }
 
+      if (@desync_hash != null) {
+        desync_hash.add(e.id());
+        desync_hash.add(lift);
+      }
+
       float x_speed = e.x_speed();
       float y_speed = e.y_speed();
       if (!lift_off_ground && e.ground()) {
@@ -189,13 +219,7 @@ class geyser : trigger_base {
     float diry = ey - cy;
     float dirn = max(1, sqrt(dirx * dirx + diry * diry));
 
-    raycast@ rc = g.ray_cast_tiles(cx + dirx/dirn * 24.0, cy + diry/dirn * 24.0, ex, ey);
-    if (rc.hit()) {
-      return false;
-    }
-
-    @rc = g.ray_cast_tiles(ex, ey, cx + dirx/dirn * 24.0, cy + diry/dirn * 24.0);
-    return !rc.hit();
+    return rays.visible(cx + dirx/dirn * 24.0, cy + diry/dirn * 24.0, ex, ey);
   }
 
 /*
@@ -214,7 +238,7 @@ class geyser : trigger_base {
     state = GEYSER_STATE_ACTIVE;
     state_timer = activation_time;
 
-    @emitter = create_entity("entity_emitter");
+    @emitter = @geyser_emitters.acquire();
     emitter.layer(emitter_layer);
     emitter.set_xy(self.x(), self.y());
 
@@ -223,6 +247,6 @@ class geyser : trigger_base {
     vars.get_var("width").set_int32(width);
     vars.get_var("height").set_int32(50);
     vars.get_var("emitter_id").set_int32(emitter_id);
-    g.add_entity(@emitter, false);
+    geyser_emitters.place(@emitter);
   }
 }
@@ -1,8 +1,24 @@
+#include "../utils/desync_detector.cpp"
+
 class script {
   scene@ g;
+  desync_detector@ detector;
+
+  [check] bool desync_check; /* Record and verify replay desync hashes */
 
   script() {
     @g = get_scene();
+    desync_check = false;
+  }
+
+  void step(int) {
+    if (desync_check && @detector == null) {
+      @detector = desync_detector();
+      @desync_hash = @detector;
+    }
+    if (@detector != null) {
+      detector.step();
+    }
   }
 }
 
@@ -0,0 +1,216 @@
+#include "input.cpp"
+
+/* draw() calls timed on the final board of each run */
+const int BENCH_DRAW_FRAMES = 60;
+
+/* Usage:
+ *
+ * Create a minesweeper_bench and call run() with an input_log, either one
+ * captured with recording_input (see the script's record_input option) or
+ * one of the generated stress logs below. Each log is fed through a
+ * minesweeper instance that isn't added to the scene and the time spent in
+ * step() on each frame is printed with puts. draw() is timed apart from the
+ * steps, on the board the run leaves behind: once to catch the render cache
+ * up with every change, then BENCH_DRAW_FRAMES times with nothing changed.
+ * run_chord() does the same with a chord_input instead of a log.
+ * run_stress() runs every built in stress workload. Compile bench_main.cpp
+ * to run them on level start; the game script doesn't include this file.
+ */
+class minesweeper_bench {
+  array<int> step_us;
+
+  void run_stress() {
+    run("cascade 256x256", 256, 256, 300, @cascade_log(256, 256));
+    run_chord("chord 128x128", 128, 128, 1600);
+    run_chord("expert chord", 16, 30, 99);
+  }
+
+  void run(string name, int rows, int cols, int bombs, input_log@ log) {
+    minesweeper@ ms = setup(rows, cols, bombs, log.seed,
+                            @scripted_input(@log));
+    int frames = log.last_frame() + 2;
+    step_us.resize(frames);
+    for (int i = 0; i < frames; i++) {
+      step_us[i] = time_step(@ms);
+    }
+    report(name, @ms);
+  }
+
+  void run_chord(string name, int rows, int cols, int bombs) {
+    chord_input@ input = @chord_input();
+    minesweeper@ ms = setup(rows, cols, bombs, 0, @input);
+    step_us.resize(0);
+    while (!input.done && !ms.dead && !ms.finished) {
+      step_us.insertLast(time_step(@ms));
+    }
+    report(name, @ms);
+  }
+
+  minesweeper@ setup(int rows, int cols, int bombs, uint seed,
+                     minesweeper_input@ input) {
+    minesweeper@ ms = @minesweeper(rows, cols, bombs, 48.0, false, false);
+    scriptenemy@ se = @create_scriptenemy(@ms);
+    se.x(0);
+    se.y(0);
+    if (@ms.self == null) {
+      ms.init(null, se);
+    }
+    ms.lock_out_timer = 0;
+    ms.headless = true;
+    @ms.input = @input;
+    ms.seed = seed;
+    return ms;
+  }
+
+  int time_step(minesweeper@ ms) {
+    int64 t0 = get_time_us();
+    ms.step();
+    return int(get_time_us() - t0);
+  }
+
+  void report(string name, minesweeper@ ms) {
+    int frames = int(step_us.size());
+    int64 step_total = 0;
+    int step_max = 0;
+    int step_worst = 0;
+    for (int i = 0; i < frames; i++) {
+      step_total += step_us[i];
+      if (step_us[i] > step_max) {
+        step_max = step_us[i];
+        step_worst = i;
+      }
+    }
+
+    int64 t0 = get_time_us();
+    ms.draw(1.0);
+    int64 t1 = get_time_us();
+    for (int i = 0; i < BENCH_DRAW_FRAMES; i++) {
+      ms.draw(1.0);
+    }
+    int64 t2 = get_time_us();
+
+    puts(name + ": " + frames + " frames, " + ms.reveal_count +
+         " revealed, " + ms.marks + " flagged");
+    puts("  step total " + step_total + "us, max " + step_max +
+         "us (frame " + step_worst + ")");
+    puts("  draw first " + (t1 - t0) + "us, then " +
+         (t2 - t1) / BENCH_DRAW_FRAMES + "us each");
+  }
+}
+
+class chord_input : minesweeper_input {
+  /* Opens the board with a left click in the middle, then sweeps it in
+   * reading order. At each revealed number it flags the unflagged mines
+   * around it, read straight off the board, and if it still has hidden
+   * neighbours middle clicks it to chord them open. Sweeps repeat until one
+   * chords nothing, then done is set. Every click is a press and a release
+   * on consecutive polls.
+   */
+  array<int> buttons; /* Queued clicks and the cells they land on */
+  array<int> cells;
+  uint next;
+  bool pressed;
+  int cursor; /* Next cell for the sweep to look at */
+  bool chorded; /* Set once the current sweep has queued a chord */
+  bool done;
+
+  chord_input() {
+    next = 0;
+    pressed = false;
+    cursor = 0;
+    chorded = false;
+    done = false;
+  }
+
+  bool poll(minesweeper@ ms, int &out mouse_state, float &out x, float &out y) {
+    if (next == buttons.size()) {
+      buttons.resize(0);
+      cells.resize(0);
+      next = 0;
+      queue(@ms);
+    }
+    if (done) {
+      return false;
+    }
+    x = cells[next] % ms.cols + 0.5;
+    y = cells[next] / ms.cols + 0.5;
+    if (pressed) {
+      mouse_state = 0;
+      next++;
+    } else {
+      mouse_state = buttons[next];
+    }
+    pressed = !pressed;
+    return true;
+  }
+
+  void click(int button, int ind) {
+    buttons.insertLast(button);
+    cells.insertLast(ind);
+  }
+
+  void queue(minesweeper@ ms) {
+    if (!ms.grid_ready) {
+      click(LEFT_CLICK, ms.grid.index(ms.rows / 2, ms.cols / 2));
+      return;
+    }
+    int n = ms.rows * ms.cols;
+    while (buttons.size() == 0) {
+      if (cursor == n) {
+        if (!chorded) {
+          done = true;
+          return;
+        }
+        cursor = 0;
+        chorded = false;
+      }
+      int ind = cursor++;
+      if (!ms.grid.revealed(ind) || ms.grid.bomb_count(ind) == 0) {
+        continue;
+      }
+      int r = ind / ms.cols;
+      int c = ind % ms.cols;
+      bool hidden = false;
+      for (int i = 0; i < 8; i++) {
+        int nr = r + dr[i];
+        int nc = c + dc[i];
+        if (nr < 0 || nr >= ms.rows || nc < 0 || nc >= ms.cols) {
+          continue;
+        }
+        int nb = ms.grid.index(nr, nc);
+        if (ms.grid.revealed(nb) || ms.grid.marked(nb)) {
+          continue;
+        }
+        if (ms.grid.bomb(nb)) {
+          click(RIGHT_CLICK, nb);
+        } else {
+          hidden = true;
+        }
+      }
+      if (hidden) {
+        click(MIDDLE_CLICK, ind);
+        chorded = true;
+      }
+    }
+  }
+}
+
+/* Presses and releases button at cell (r, c) starting at frame. Returns the
+ * frame after the release. */
+int bench_click(input_log@ log, int frame, int button, int r, int c) {
+  log.add(frame, button, c + 0.5, r + 0.5);
+  log.add(frame + 1, 0, c + 0.5, r + 0.5);
+  return frame + 2;
+}
+
+input_log@ cascade_log(int rows, int cols) {
+  /* A first click in the middle of a sparse board, then a click in each
+   * corner, each of which tends to open a huge cascade. */
+  input_log log;
+  int frame = bench_click(@log, 0, LEFT_CLICK, rows / 2, cols / 2);
+  frame = bench_click(@log, frame, LEFT_CLICK, 0, 0);
+  frame = bench_click(@log, frame, LEFT_CLICK, 0, cols - 1);
+  frame = bench_click(@log, frame, LEFT_CLICK, rows - 1, 0);
+  frame = bench_click(@log, frame, LEFT_CLICK, rows - 1, cols - 1);
+  return log;
+}
@@ -0,0 +1,109 @@
+#include "../utils/bitset.cpp"
+
+class board {
+  /* Flat row-major storage of the minesweeper cell state. Cells are addressed
+   * by their index r * cols + c. Each boolean property is kept in its own
+   * bitset and the adjacent mine counts are packed four bits per cell.
+   */
+  int rows;
+  int cols;
+
+  bitset bomb_bits; // Is the cell a mine or not
+  bitset killed_bits; // If a mine, did this mine kill the player?
+  bitset revealed_bits; // Are the contents of this cell visible?
+  bitset marked_bits; // Has the user "marked" this cell with a flag?
+  nibble_array counts; // Number of adjacent mines to each cell
+
+  /* counts is stored with a one cell border on every side so that placing a
+   * mine can bump all eight neighbours without any bounds checks. stride is
+   * the padded row length and neighbour_offsets the padded index deltas to
+   * each neighbour.
+   */
+  int stride;
+  array<int> neighbour_offsets(8);
+
+  board() {
+    rows = 0;
+    cols = 0;
+  }
+
+  void resize(int rows, int cols) {
+    this.rows = rows;
+    this.cols = cols;
+    int n = rows * cols;
+    bomb_bits.resize(n);
+    killed_bits.resize(n);
+    revealed_bits.resize(n);
+    marked_bits.resize(n);
+
+    stride = cols + 2;
+    counts.resize((rows + 2) * stride);
+    neighbour_offsets[0] = -stride - 1;
+    neighbour_offsets[1] = -stride;
+    neighbour_offsets[2] = -stride + 1;
+    neighbour_offsets[3] = -1;
+    neighbour_offsets[4] = 1;
+    neighbour_offsets[5] = stride - 1;
+    neighbour_offsets[6] = stride;
+    neighbour_offsets[7] = stride + 1;
+  }
+
+  /* Resets every cell to an empty, hidden, unmarked cell. */
+  void clear() {
+    bomb_bits.clear();
+    killed_bits.clear();
+    revealed_bits.clear();
+    marked_bits.clear();
+    counts.clear();
+  }
+
+  /* Maps a cell index onto its position in the padded counts array. */
+  int padded(int ind) const {
+    return ind + (ind / cols) * 2 + stride + 1;
+  }
+
+  /* Marks a cell as a mine and increments the count of each neighbour. */
+  void add_bomb(int ind) {
+    bomb_bits.set(ind, true);
+    int p = padded(ind);
+    for (int i = 0; i < 8; i++) {
+      counts.add(p + neighbour_offsets[i], 1);
+    }
+  }
+
+  /* Reverses add_bomb. */
+  void remove_bomb(int ind) {
+    bomb_bits.set(ind, false);
+    int p = padded(ind);
+    for (int i = 0; i < 8; i++) {
+      counts.add(p + neighbour_offsets[i], -1);
+    }
+  }
+
+  int size() const {
+    return rows * cols;
+  }
+
+  int index(int r, int c) const {
+    return r * cols + c;
+  }
+
+  bool in_bounds(int r, int c) const {
+    return 0 <= r && r < rows && 0 <= c && c < cols;
+  }
+
+  bool bomb(int ind) const { return bomb_bits.get(ind); }
+  void bomb(int ind, bool val) { bomb_bits.set(ind, val); }
+
+  bool killed(int ind) const { return killed_bits.get(ind); }
+  void killed(int ind, bool val) { killed_bits.set(ind, val); }
+
+  bool revealed(int ind) const { return revealed_bits.get(ind); }
+  void revealed(int ind, bool val) { revealed_bits.set(ind, val); }
+
+  bool marked(int ind) const { return marked_bits.get(ind); }
+  void marked(int ind, bool val) { marked_bits.set(ind, val); }
+
+  int bomb_count(int ind) const { return counts.get(padded(ind)); }
+  void bomb_count(int ind, int val) { counts.set(padded(ind), val); }
+}
@@ -0,0 +1,928 @@
+#include "replay_rand.cpp"
+#include "../utils/random.cpp"
+#include "board.cpp"
+#include "render_cache.cpp"
+#include "infinite.cpp"
+#include "no_guess.cpp"
+#include "probability.cpp"
+#include "snapshot.cpp"
+#include "input.cpp"
+
+/* Mouse state masks from the API */
+const int LEFT_CLICK = 0x4;
+const int RIGHT_CLICK = 0x8;
+const int MIDDLE_CLICK = 0x10;
+
+/* Candidates drawn plus solver steps taken per frame of no-guess board
+ * generation. A fixed count rather than a time budget, so input resumes on
+ * the same frame in replays. */
+const int NO_GUESS_STEPS_PER_FRAME = 64;
+
+/* Utility arrays to help enumerate neighbors of a cell */
+const array<int> dr = {-1, 0, 1, 0, -1, -1, 1, 1};
+const array<int> dc = {0, -1, 0, 1, -1, 1, -1, 1};
+
+// Just eyeballed these, not an exact match to anything.
+const uint COLOR_UNPRESSED_CELL = 0xFF777777;
+const uint COLOR_UNPRESSED_TOP = 0xFFDDDDDD;
+const uint COLOR_UNPRESSED_LFT = 0xFFDDDDDD;
+const uint COLOR_UNPRESSED_BOT = 0xFF666666;
+const uint COLOR_UNPRESSED_RHT = 0xFF666666;
+const uint COLOR_PRESSED_CELL = 0xFF666666;
+const uint COLOR_PRESSED_BORDER = 0xFF333333;
+const uint COLOR_REVEALED_CELL = 0xFF555555;
+const uint COLOR_REVEALED_BORDER = 0xFF111111;
+const uint COLOR_PROB_SKIPPED = 0x60FFFFFF;
+
+// Pulled these colors out of a screenshot of the classic game.
+const array<uint> COLOR_COUNTS = {
+  0,
+  0xFF0100FE, // 1
+  0xFF017F01, // 2
+  0xFFFE0000, // 3
+  0xFF010080, // 4
+  0xFF810102, // 5
+  0xFF008081, // 6
+  0xFF000000, // 7
+  0xFF808080, // 8
+};
+
+textfield@ make_text(uint colour) {
+  textfield@ txt = @create_textfield();
+  txt.set_font("Caracteres", 36);
+  txt.align_horizontal(0);
+  txt.align_vertical(0);
+  txt.colour(colour);
+  return txt;
+}
+
+void draw_cell_bg(canvas@ cvs, float x, float y, int bg) {
+  /* Draws the background of the cell whose top left corner is at (x, y) in
+   * the given CELL_BG_* style. The canvas sub layer must already be set.
+   */
+  if (bg == CELL_BG_REVEALED) {
+    draw_cell_frame(@cvs, x, y, 0.02, COLOR_REVEALED_CELL,
+                    COLOR_REVEALED_BORDER, COLOR_REVEALED_BORDER,
+                    COLOR_REVEALED_BORDER, COLOR_REVEALED_BORDER);
+  } else if (bg == CELL_BG_PRESSED) {
+    draw_cell_frame(@cvs, x, y, 0.02, COLOR_PRESSED_CELL,
+                    COLOR_PRESSED_BORDER, COLOR_PRESSED_BORDER,
+                    COLOR_PRESSED_BORDER, COLOR_PRESSED_BORDER);
+  } else {
+    draw_cell_frame(@cvs, x, y, 0.1, COLOR_UNPRESSED_CELL,
+                    COLOR_UNPRESSED_TOP, COLOR_UNPRESSED_LFT,
+                    COLOR_UNPRESSED_BOT, COLOR_UNPRESSED_RHT);
+  }
+}
+
+void draw_cell_hatch(canvas@ cvs, float x, float y, uint colour) {
+  /* Crosses out the cell whose top left corner is at (x, y). */
+  cvs.draw_rectangle(x + 0.1, y + 0.47, x + 0.9, y + 0.53, 45, colour);
+  cvs.draw_rectangle(x + 0.1, y + 0.47, x + 0.9, y + 0.53, -45, colour);
+}
+
+void draw_cell_frame(canvas@ cvs, float x, float y, float m, uint c_cell,
+                     uint c_top, uint c_lft, uint c_bot, uint c_rht) {
+  /* Draws the cell as an outer rectangle in the top border colour with the
+   * remaining sides layered over it as quads, then the inner cell. Sides
+   * matching the top colour are skipped so uniform borders take just two
+   * rectangles.
+   */
+  cvs.draw_rectangle(x, y, x + 1, y + 1, 0, c_top);
+  if (c_lft != c_top) {
+    cvs.draw_quad(
+      false, x, y, x + m, y + m, x + m, y + 1 - m, x, y + 1,
+      c_lft, c_lft, c_lft, c_lft
+    );
+  }
+  if (c_bot != c_top) {
+    cvs.draw_quad(
+      false, x, y + 1, x + 1, y + 1, x + 1 - m, y + 1 - m, x + m, y + 1 - m,
+      c_bot, c_bot, c_bot, c_bot
+    );
+  }
+  if (c_rht != c_top) {
+    cvs.draw_quad(
+      false, x + 1, y, x + 1, y + 1, x + 1 - m, y + 1 - m, x + 1 - m, y + m,
+      c_rht, c_rht, c_rht, c_rht
+    );
+  }
+  cvs.draw_rectangle(x + m, y + m, x + 1 - m, y + 1 - m, 0, c_cell);
+}
+
+class single_sprite {
+  /* Container class that manages sprites object and drawing of a single sprite
+   * frame. Performs measurements so that the sprite can be drawn centered and
+   * of a specified radius into a passed canvas.
+   */
+  sprites@ spr;
+
+  string sprite_name;
+  int frame;
+  int palette;
+
+  float top, lft, bot, rht;
+
+  single_sprite(string sprite_set, string sprite_name, int frame, int palette) {
+    @spr = @create_sprites();
+    spr.add_sprite_set(sprite_set);
+
+    this.sprite_name = sprite_name;
+    this.frame = frame;
+    this.palette = palette;
+
+    rectangle@ rec = spr.get_sprite_rect(sprite_name, frame);
+    top = rec.top();
+    lft = rec.left();
+    bot = rec.bottom();
+    rht = rec.right();
+  }
+
+  void draw(canvas@ cvs, float cx, float cy, float radius, float rotation=0, int colour=0xFFFFFFFF) {
+    float actual_scale = max(rht - lft, bot - top);
+    float scale_factor = radius / actual_scale * 2;
+    cvs.draw_sprite(
+      @spr, sprite_name, frame, palette,
+      cx - (lft + rht) / 2 * scale_factor, cy - (top + bot) / 2 * scale_factor,
+      rotation, scale_factor, scale_factor, colour
+    );
+  }
+}
+
+class minesweeper : enemy_base {
+  /* Minesweeper controllable */
+  int rows;
+  int cols;
+  int bombs;
+  int marks; /* count of number of marked cells */
+  float tile_size;
+
+  bool grid_ready;
+  board grid;
+  array<int> coords; /* Shuffle buffer used by make_grid */
+  array<int> swaps; /* Swap log used to restore coords after make_grid */
+  uint seed; /* Replay seed, taken from the script when the grid is made */
+  pcg32 rng; /* Board generation stream */
+  bool no_guess;
+  no_guess_generator@ generator; /* Set while a no-guess layout is generated */
+  job_scheduler@ jobs; /* Runs generator across frames */
+  bool show_probabilities;
+  probability_overlay probs;
+  bool undo_keys; /* Bind undo and redo to light and heavy attack */
+
+  /* Bit-packed board state kept current every step so it survives
+   * checkpoint reloads, and the per step delta log used for undo. */
+  [hidden] array<uint> saved_state;
+  board_snapshot@ persisted;
+  board_log history;
+
+  array<int> changed; /* Cells whose state changed during the last step */
+  bitset visited; /* Cells already enqueued by the current flood fill */
+  array<int> visited_list; /* Indices set in visited, used to clear it */
+  array<int> fill_stack; /* Pending span seeds of the current flood fill */
+
+  render_cache cache; /* Per cell draw styles, refreshed only when dirty */
+  int pressed_r; /* Center and radius of the cells drawn pressed, radius -1 */
+  int pressed_c; /* when nothing is pressed */
+  int pressed_radius;
+  array<int> views; /* Cells each camera can see as r0, c0, r1, c1 */
+  bool all_visible; /* Set when some camera sees the whole board */
+
+  int reveal_count; /* Numver of cells that have been revealed */
+  bool dead; /* Set when the player reveals a mine */
+  bool finished; /* Set when the player reveals all non-mines */
+  bool show_mouse;
+  bool headless; /* Set when driven by a benchmark outside the scene */
+
+  scene@ g;
+  script@ s;
+  scriptenemy@ self;
+  canvas@ cvs;
+  textfield@ counter_txt; /* Remaining mine counter */
+  int counter_value; /* Value currently shown by counter_txt */
+  array<textfield@> count_txts; /* Pre-built digit for each count 1-8 */
+
+  single_sprite@ flag;
+  single_sprite@ bomb;
+
+  minesweeper_input@ input; /* Source of mouse input, the scene by default */
+  int lock_out_timer; /* Timer at the start after spawning locking out inputs */
+  int last_mouse_st; /* The mouse state from the last time step() was called */
+  int last_r; /* (last_r, last_c) give the coordinates of the mouse last step */
+  int last_c;
+
+  minesweeper(int rows, int cols, int bombs, float tile_size, bool no_guess,
+              bool show_probabilities, bool undo_keys = false) {
+    this.rows = rows;
+    this.cols = cols;
+    this.bombs = bombs;
+    this.tile_size = tile_size;
+    this.no_guess = no_guess;
+    this.show_probabilities = show_probabilities;
+    this.undo_keys = undo_keys;
+    @g = @get_scene();
+    @input = @scene_input();
+    headless = false;
+    seed = 0;
+    @jobs = @job_scheduler(NO_GUESS_STEPS_PER_FRAME);
+  }
+
+  void make_grid(int avoid_r, int avoid_c) {
+    /* Assigns mines to cells and calculates the bomb_count cell metadata.
+     * This uses the rng stream and happens when the user clicks on the first
+     * cell.
+     *
+     * coords holds every cell index except the avoided cell (entry k maps to
+     * cell k, or k + 1 past the avoided cell). Only the first `bombs` entries
+     * of a partial Fisher-Yates shuffle are touched and the swaps are undone
+     * afterwards so the buffer can be reused without rebuilding it.
+     */
+    int avoid = grid.index(avoid_r, avoid_c);
+    int n = int(coords.size());
+    int placed = min(bombs, n);
+    swaps.resize(placed);
+    for (int i = 0; i < placed; i++) {
+      int j = i + int(rng.below(uint(n - i)));
+      int ind = coords[j];
+      coords[j] = coords[i];
+      coords[i] = ind;
+      swaps[i] = j;
+      ind = ind < avoid ? ind : ind + 1;
+      grid.add_bomb(ind);
+      history.record(ind, LOG_BOMB);
+    }
+    for (int i = placed - 1; i >= 0; i--) {
+      int j = swaps[i];
+      int tmp = coords[j];
+      coords[j] = coords[i];
+      coords[i] = tmp;
+    }
+    grid_ready = true;
+  }
+
+  void seed_rng() {
+    /* Without a script (e.g. in a benchmark) seed must be set directly. */
+    if (@s != null) {
+      seed = s.rrnd.seed;
+    }
+    rng.seed(seed, "minesweeper.grid");
+  }
+
+  void init(script@ s, scriptenemy@ self) {
+    @this.s = @s;
+    @this.self = @self;
+    @cvs = create_canvas(false, self.layer(), 1);
+    @counter_txt = @make_text(0xFFFFFFFF);
+    counter_value = bombs - marks;
+    counter_txt.text("" + counter_value);
+    count_txts.resize(9);
+    for (int count = 1; count <= 8; count++) {
+      @count_txts[count] = @make_text(COLOR_COUNTS[count]);
+      count_txts[count].text("" + count);
+    }
+    @flag = @single_sprite("flag", "cidle", 1, 1);
+    @bomb = @single_sprite("editor", "skull", 0, 1);
+
+    grid_ready = false;
+    grid.resize(rows, cols);
+    visited.resize(rows * cols);
+    cache.resize(rows * cols);
+    probs.reset(@grid, bombs);
+    pressed_r = pressed_c = pressed_radius = -1;
+    coords.resize(max(0, rows * cols - 1));
+    for (int i = 0; i < int(coords.size()); i++) {
+      coords[i] = i;
+    }
+
+    @persisted = @board_snapshot(@saved_state);
+    if (!persisted.empty()) {
+      int flags;
+      if (persisted.restore(@grid, marks, reveal_count, flags)) {
+        apply_flags(flags);
+        if (show_probabilities && grid_ready) {
+          array<int> all(rows * cols);
+          for (int i = 0; i < rows * cols; i++) {
+            all[i] = i;
+          }
+          probs.update(@all, marks);
+        }
+      } else {
+        saved_state.resize(0);
+      }
+    }
+    lock_out_timer = 55;
+  }
+
+  void step() {
+    changed.resize(0);
+    if (history_input()) {
+      return;
+    }
+    history.begin(state_flags(), marks, reveal_count);
+    if (dead || finished) {
+      return;
+    }
+    if (lock_out_timer > 0) {
+      lock_out_timer--;
+      return;
+    }
+
+    if (@generator != null) {
+      /* Input is ignored until the no-guess layout is ready, after which the
+       * first click is revealed. */
+      last_mouse_st = 0;
+      jobs.step();
+      if (!generator.done) {
+        return;
+      }
+      generator.apply(@grid);
+      for (int i = 0; i < rows * cols; i++) {
+        if (grid.bomb(i)) {
+          history.record(i, LOG_BOMB);
+        }
+      }
+      grid_ready = true;
+      array<int> first = {generator.first};
+      @generator = null;
+      reveal_cells(@first, @changed);
+      on_cells_changed();
+      return;
+    }
+
+    /* Figure out what cell the mouse is over and what the mouse state is. */
+    int mst;
+    float x, y;
+    if (!input.poll(@this, mst, x, y)) {
+      last_mouse_st = 0;
+      return;
+    }
+
+    last_r = int(floor(y));
+    last_c = int(floor(x));
+    if (last_r < 0 || last_r >= rows || last_c < 0 || last_c >= cols) {
+      last_mouse_st = mst;
+      return;
+    }
+
+    int cur = grid.index(last_r, last_c);
+    if ((mst & RIGHT_CLICK) != 0 && (last_mouse_st & RIGHT_CLICK) == 0) {
+      // pos-edge right click
+      if (!grid.revealed(cur)) {
+        bool marked = !grid.marked(cur);
+        grid.marked(cur, marked);
+        marks += marked ? 1 : -1;
+        changed.insertLast(cur);
+        history.record(cur, LOG_MARK);
+      }
+    }
+
+    array<int> reveal;
+    bool left_click = (mst & LEFT_CLICK) == 0 && (last_mouse_st & LEFT_CLICK) != 0;
+    bool middle_click = (mst & MIDDLE_CLICK) == 0 && (last_mouse_st & MIDDLE_CLICK) != 0;
+    if (!grid.marked(cur) && (left_click || middle_click)) {
+      /* Figure out what set of cells to should be revealed based on the click.
+       * left/middle clicking a revealed cell should reveal all its neighbors.
+       */
+      if (grid.revealed(cur)) {
+        int cnt = 0;
+        for (int i = 0; i < 8; i++) {
+          int nr = last_r + dr[i];
+          int nc = last_c + dc[i];
+          if (nr < 0 || nr >= rows || nc < 0 || nc >= cols) {
+            continue;
+          }
+          if (grid.marked(nr * cols + nc)) {
+            cnt++;
+          } else {
+            reveal.insertLast(nr * cols + nc);
+          }
+        }
+        if (cnt != grid.bomb_count(cur)) {
+          reveal.resize(0);
+        }
+      } else if (left_click) {
+        /* left clicking an unrevealed cell should reveal just that cell */
+        reveal.insertLast(cur);
+      }
+    }
+
+    /* Create the grid if this is the first click */
+    if (reveal.size() != 0 && !grid_ready) {
+      seed_rng();
+      if (no_guess) {
+        @generator = @no_guess_generator(rows, cols, bombs, last_r, last_c,
+                                         @rng);
+        jobs.submit(@generator);
+        /* A right click on the same frame has already changed a cell. */
+        on_cells_changed();
+        last_mouse_st = mst;
+        return;
+      }
+      make_grid(last_r, last_c);
+    }
+
+    if (reveal.size() != 0) {
+      reveal_cells(@reveal, @changed);
+    }
+
+    on_cells_changed();
+
+    last_mouse_st = mst;
+
+    if (dead) {
+      /* Can uncomment if you want the player to die when they reveal a mine. I
+       * optted to just lock the user out of input so they can continue to look
+       * at the board state.
+       */
+      // g.load_checkpoint();
+    }
+  }
+  
+  void on_cells_changed() {
+    /* Checked here rather than at the next step so the winning step's log
+     * entry and snapshot already hold the finished flag. */
+    if (grid_ready && !dead && !finished &&
+        reveal_count + bombs == rows * cols) {
+      finished = true;
+      if (!headless) {
+        g.end_level(self.x(), self.y());
+      }
+    }
+
+    /* Death reveals every cell so restyle the whole board. */
+    if (dead) {
+      cache.invalidate_all();
+    }
+    for (uint i = 0; i < changed.size(); i++) {
+      cache.invalidate(changed[i]);
+    }
+    if (show_probabilities && grid_ready && !dead && changed.size() != 0) {
+      probs.update(@changed, marks);
+    }
+
+    int flags = state_flags();
+    history.end(flags, marks, reveal_count);
+    save_state(flags);
+  }
+
+  int state_flags() {
+    return (grid_ready ? BOARD_FLAG_READY : 0) |
+           (dead ? BOARD_FLAG_DEAD : 0) |
+           (finished ? BOARD_FLAG_FINISHED : 0);
+  }
+
+  void apply_flags(int flags) {
+    grid_ready = (flags & BOARD_FLAG_READY) != 0;
+    dead = (flags & BOARD_FLAG_DEAD) != 0;
+    finished = (flags & BOARD_FLAG_FINISHED) != 0;
+  }
+
+  void save_state(int flags) {
+    /* The full board is only written when mines are placed or removed;
+     * otherwise just the words holding changed cells are rewritten. */
+    if ((persisted.flags() & BOARD_FLAG_READY) != (flags & BOARD_FLAG_READY) ||
+        persisted.empty()) {
+      persisted.take(@grid, marks, reveal_count, flags);
+    } else {
+      persisted.update(@grid, @changed);
+      persisted.counters(marks, reveal_count, flags);
+    }
+  }
+
+  bool undo() {
+    return step_history(false);
+  }
+
+  bool redo() {
+    return step_history(true);
+  }
+
+  /* With undo_keys set, light attack undoes the last logged step and heavy
+   * attack redoes it. Returns true if either ran. Ignored while the board is
+   * locked out or a no-guess layout is being generated. */
+  bool history_input() {
+    if (!undo_keys || headless || lock_out_timer > 0 || @generator != null) {
+      return false;
+    }
+    if (0 < self.light_intent() && self.light_intent() <= 10) {
+      self.light_intent(11);
+      return undo();
+    }
+    if (0 < self.heavy_intent() && self.heavy_intent() <= 10) {
+      self.heavy_intent(11);
+      return redo();
+    }
+    return false;
+  }
+
+  /* Refused once the game is over, so a lost or won board stays that way. */
+  bool step_history(bool forward) {
+    if (dead || finished) {
+      return false;
+    }
+    changed.resize(0);
+    bool ok = forward ? history.redo(@grid, @changed) :
+                        history.undo(@grid, @changed);
+    if (!ok) {
+      return false;
+    }
+
+    int flags = history.counter(0);
+    marks = history.counter(1);
+    reveal_count = history.counter(2);
+    apply_flags(flags);
+
+    if (dead) {
+      cache.invalidate_all();
+    }
+    for (uint i = 0; i < changed.size(); i++) {
+      cache.invalidate(changed[i]);
+    }
+    if (show_probabilities) {
+      if (!grid_ready) {
+        probs.reset(@grid, bombs);
+      } else if (!dead) {
+        probs.update(@changed, marks);
+      }
+    }
+    save_state(flags);
+    return true;
+  }
+
+  bool expandable(int ind) {
+    /* A cell floods into its neighbours when it's revealed with no adjacent
+     * mines. */
+    return !grid.revealed(ind) && grid.bomb_count(ind) == 0;
+  }
+
+  void visit(int ind) {
+    visited.set(ind, true);
+    visited_list.insertLast(ind);
+  }
+
+  void reveal_cell(int ind, array<int>@ changed) {
+    if (grid.revealed(ind)) {
+      return;
+    }
+    grid.revealed(ind, true);
+    reveal_count++;
+    if (grid.bomb(ind)) {
+      dead = true;
+      grid.killed(ind, true);
+    }
+    changed.insertLast(ind);
+    history.record(ind, LOG_REVEAL);
+  }
+
+  void reveal_cells(array<int>@ seeds, array<int>@ changed) {
+    /* Reveal all cells in seeds. If one or more of those cells has no bomb
+     * neighbors automatically expand into its neighbors. The fill works a
+     * row span at a time: a popped seed is extended left and right across
+     * expandable cells and then the rows above and below the span are scanned
+     * for new seeds. Cells are marked in the visited bitset as they are
+     * enqueued or absorbed into a span so each cell is handled at most once.
+     * The index of every newly revealed cell is appended to changed.
+     */
+    fill_stack.resize(0);
+    for (uint i = 0; i < seeds.size(); i++) {
+      int ind = seeds[i];
+      if (!visited.get(ind)) {
+        visit(ind);
+        fill_stack.insertLast(ind);
+      }
+    }
+
+    while (fill_stack.size() != 0) {
+      int ind = fill_stack[fill_stack.size() - 1];
+      fill_stack.removeLast();
+      if (!expandable(ind)) {
+        reveal_cell(ind, changed);
+        continue;
+      }
+
+      int row = ind / cols;
+      int base = row * cols;
+      int lo = ind - base;
+      int hi = lo;
+      while (lo > 0 && !visited.get(base + lo - 1) && expandable(base + lo - 1)) {
+        lo--;
+        visit(base + lo);
+      }
+      while (hi + 1 < cols && !visited.get(base + hi + 1) && expandable(base + hi + 1)) {
+        hi++;
+        visit(base + hi);
+      }
+      for (int c = lo; c <= hi; c++) {
+        reveal_cell(base + c, changed);
+      }
+
+      /* The cells just past either end of the span can't expand. */
+      if (lo > 0 && !visited.get(base + lo - 1)) {
+        visit(base + lo - 1);
+        reveal_cell(base + lo - 1, changed);
+      }
+      if (hi + 1 < cols && !visited.get(base + hi + 1)) {
+        visit(base + hi + 1);
+        reveal_cell(base + hi + 1, changed);
+      }
+
+      /* Scan the diagonal-inclusive range of the rows above and below. Only
+       * the first cell of each run of expandable cells is pushed; the rest of
+       * the run is absorbed when that seed is extended.
+       */
+      int c0 = max(0, lo - 1);
+      int c1 = min(cols - 1, hi + 1);
+      for (int nr = row - 1; nr <= row + 1; nr += 2) {
+        if (nr < 0 || nr >= rows) {
+          continue;
+        }
+        int nbase = nr * cols;
+        bool in_run = false;
+        for (int c = c0; c <= c1; c++) {
+          int nind = nbase + c;
+          if (visited.get(nind)) {
+            in_run = false;
+          } else if (expandable(nind)) {
+            if (!in_run) {
+              visit(nind);
+              fill_stack.insertLast(nind);
+              in_run = true;
+            }
+          } else {
+            visit(nind);
+            reveal_cell(nind, changed);
+            in_run = false;
+          }
+        }
+      }
+    }
+
+    for (uint i = 0; i < visited_list.size(); i++) {
+      visited.set(visited_list[i], false);
+    }
+    visited_list.resize(0);
+  }
+
+  void draw(float) {
+    float ent_x = self.x();
+    float ent_y = self.y();
+    float lft = ent_x - cols / 2.0 * tile_size;
+    float top = ent_y - rows / 2.0 * tile_size;
+
+    cvs.reset();
+    cvs.layer(self.layer());
+    cvs.multiply(tile_size, 0, 0, tile_size, lft, top);
+    update_views(lft, top);
+
+    if (counter_value != bombs - marks) {
+      counter_value = bombs - marks;
+      counter_txt.text("" + counter_value);
+    }
+    float txt_scale = 0.8 / 36.0;
+    cvs.draw_text(@counter_txt, 1, -1, txt_scale, txt_scale, 0);
+
+    update_pressed();
+    if (!cache.clean()) {
+      refresh_cache();
+    }
+
+    /* Emit every cached group. Backgrounds are all drawn before any overlay
+     * so overlays sharing sub layer 1 stay on top.
+     */
+    cvs.sub_layer(1);
+    for (int bg = 0; bg < NUM_CELL_BGS; bg++) {
+      draw_bgs(@cache.bgs.members[bg], bg);
+    }
+
+    draw_flags(@cache.overlays.members[CELL_OVERLAY_FLAG]);
+    draw_bombs(@cache.overlays.members[CELL_OVERLAY_BOMB], false);
+    draw_bombs(@cache.overlays.members[CELL_OVERLAY_KILLED], true);
+    for (int count = 1; count <= 8; count++) {
+      draw_counts(@cache.overlays.members[CELL_OVERLAY_COUNT + count], count);
+    }
+    if (show_probabilities && !dead) {
+      draw_probabilities();
+    }
+
+    if (is_replay()) {
+      int player = self.player_index();
+      if (player != -1) {
+        int layer = self.layer();
+        float x = g.mouse_x_world(player, layer);
+        float y = g.mouse_y_world(player, layer);
+        g.draw_rectangle_world(layer, 10, x - 5, y - 5, x + 5, y + 5, 0, 0xFFFF0000);
+      }
+    }
+  }
+
+  void update_views(float lft, float top) {
+    /* Collects the range of cells each camera can see. draw() runs once per
+     * frame and the engine shows its output on every camera, so cells seen by
+     * several cameras are still drawn once and cells nobody sees are skipped.
+     * Benchmarks aren't placed in the scene and draw everything.
+     */
+    views.resize(0);
+    all_visible = headless;
+    bool any_camera = false;
+    for (int i = 0; i < int(num_cameras()) && !all_visible; i++) {
+      camera@ cam = @get_camera(i);
+      if (@cam == null) {
+        continue;
+      }
+      any_camera = true;
+      float half_w = view_half_w(cam);
+      float half_h = view_half_h(cam);
+      int c0 = max(0, int(floor((cam.x() - half_w - lft) / tile_size)));
+      int c1 = min(cols - 1, int(floor((cam.x() + half_w - lft) / tile_size)));
+      int r0 = max(0, int(floor((cam.y() - half_h - top) / tile_size)));
+      int r1 = min(rows - 1, int(floor((cam.y() + half_h - top) / tile_size)));
+      if (r0 == 0 && c0 == 0 && r1 == rows - 1 && c1 == cols - 1) {
+        all_visible = true;
+      } else if (r0 <= r1 && c0 <= c1) {
+        views.insertLast(r0);
+        views.insertLast(c0);
+        views.insertLast(r1);
+        views.insertLast(c1);
+      }
+    }
+    if (!any_camera) {
+      all_visible = true;
+    }
+  }
+
+  bool visible(int ind) const {
+    if (all_visible) {
+      return true;
+    }
+    int r = ind / cols;
+    int c = ind % cols;
+    for (uint i = 0; i < views.size(); i += 4) {
+      if (views[i] <= r && r <= views[i + 2] &&
+          views[i + 1] <= c && c <= views[i + 3]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void update_pressed() {
+    /* Work out which cells are drawn pressed from the mouse state and
+     * invalidate the cached style of any cell entering or leaving that set.
+     */
+    bool on_revealed_cell = 0 <= last_r && last_r < rows &&
+        0 <= last_c && last_c < cols &&
+        grid.revealed(grid.index(last_r, last_c));
+
+    bool pressing = (last_mouse_st & LEFT_CLICK) != 0 || (
+      on_revealed_cell && (last_mouse_st & MIDDLE_CLICK) != 0
+    );
+
+    int r = -1;
+    int c = -1;
+    int radius = -1;
+    if (pressing && 0 <= last_r && last_r < rows && 0 <= last_c && last_c < cols) {
+      r = last_r;
+      c = last_c;
+      radius = on_revealed_cell ? 1 : 0;
+    }
+    if (r == pressed_r && c == pressed_c && radius == pressed_radius) {
+      return;
+    }
+    invalidate_pressed();
+    pressed_r = r;
+    pressed_c = c;
+    pressed_radius = radius;
+    invalidate_pressed();
+  }
+
+  void invalidate_pressed() {
+    for (int i = pressed_r - pressed_radius; i <= pressed_r + pressed_radius; i++) {
+      for (int j = pressed_c - pressed_radius; j <= pressed_c + pressed_radius; j++) {
+        if (grid.in_bounds(i, j)) {
+          cache.invalidate(grid.index(i, j));
+        }
+      }
+    }
+  }
+
+  bool is_pressed(int r, int c) {
+    return pressed_radius >= 0 &&
+        abs(r - pressed_r) <= pressed_radius &&
+        abs(c - pressed_c) <= pressed_radius;
+  }
+
+  void refresh_cache() {
+    if (cache.all_dirty) {
+      for (int i = 0; i < rows * cols; i++) {
+        refresh_cell(i);
+      }
+    } else {
+      for (uint i = 0; i < cache.dirty_list.size(); i++) {
+        refresh_cell(cache.dirty_list[i]);
+      }
+    }
+    cache.mark_clean();
+  }
+
+  void refresh_cell(int ind) {
+    bool revealed = grid.revealed(ind) || dead;
+
+    int bg = CELL_BG_UNPRESSED;
+    if (revealed) {
+      bg = CELL_BG_REVEALED;
+    } else if (is_pressed(ind / cols, ind % cols)) {
+      bg = CELL_BG_PRESSED;
+    }
+
+    int overlay = CELL_OVERLAY_NONE;
+    if (!revealed) {
+      if (grid.marked(ind)) {
+        overlay = CELL_OVERLAY_FLAG;
+      }
+    } else if (grid.bomb(ind)) {
+      overlay = grid.killed(ind) ? CELL_OVERLAY_KILLED : CELL_OVERLAY_BOMB;
+    } else if (grid.bomb_count(ind) != 0) {
+      overlay = CELL_OVERLAY_COUNT + grid.bomb_count(ind);
+    }
+    cache.update(ind, bg, overlay);
+  }
+
+  void draw_bgs(array<int>@ cells, int bg) {
+    for (uint i = 0; i < cells.size(); i++) {
+      int ind = cells[i];
+      if (!visible(ind)) {
+        continue;
+      }
+      draw_cell_bg(@cvs, ind % cols, ind / cols, bg);
+    }
+  }
+
+  void draw_probabilities() {
+    /* Tints each unknown frontier cell from green (safe) to red (mine).
+     * Cells of components too large to enumerate are hatched instead, and
+     * cells without a probability (e.g. behind a wrong flag) are skipped.
+     */
+    cvs.sub_layer(10);
+    for (uint i = 0; i < probs.comps.size(); i++) {
+      prob_component@ comp = @probs.comps[i];
+      if (@comp == null || (comp.enumerated && !comp.valid)) {
+        continue;
+      }
+      for (uint j = 0; j < comp.cells.size(); j++) {
+        int ind = comp.cells[j];
+        if (!visible(ind)) {
+          continue;
+        }
+        float x = ind % cols;
+        float y = ind / cols;
+        if (!comp.enumerated) {
+          draw_cell_hatch(@cvs, x, y, COLOR_PROB_SKIPPED);
+          continue;
+        }
+        if (comp.prob[j] < 0) {
+          continue;
+        }
+        uint red = uint(round(comp.prob[j] * 255));
+        uint colour = 0x60000000 | (red << 16) | ((255 - red) << 8);
+        cvs.draw_rectangle(x + 0.1, y + 0.1, x + 0.9, y + 0.9, 0, colour);
+      }
+    }
+  }
+
+  void draw_flags(array<int>@ cells) {
+    for (uint i = 0; i < cells.size(); i++) {
+      int ind = cells[i];
+      if (!visible(ind)) {
+        continue;
+      }
+      flag.draw(@cvs, ind % cols + 0.5, ind / cols + 0.5, 0.35);
+    }
+  }
+
+  void draw_bombs(array<int>@ cells, bool killed) {
+    uint colour = killed ? 0xFFFF7777 : 0xFFFFFFFF;
+    for (uint i = 0; i < cells.size(); i++) {
+      int ind = cells[i];
+      if (!visible(ind)) {
+        continue;
+      }
+      bomb.draw(@cvs, ind % cols + 0.5, ind / cols + 0.5, 0.35, 0, colour);
+    }
+  }
+
+  void draw_counts(array<int>@ cells, int count) {
+    if (cells.size() == 0) {
+      return;
+    }
+    cvs.sub_layer(1 + count);
+    textfield@ txt = @count_txts[count];
+    float txt_scale = 0.8 / 36.0;
+    for (uint i = 0; i < cells.size(); i++) {
+      int ind = cells[i];
+      if (!visible(ind)) {
+        continue;
+      }
+      cvs.draw_text(@txt, ind % cols + 0.5, ind / cols + 0.5, txt_scale, txt_scale, 0);
+    }
+  }
+}
@@ -0,0 +1,618 @@
+#include "../utils/bitset.cpp"
+#include "../utils/random.cpp"
+#include "../utils/hash_map.cpp"
+
+/* Chunks are CHUNK_SIZE x CHUNK_SIZE cells. Cell (x, y) lives in chunk
+ * (x >>> CHUNK_SHIFT, y >>> CHUNK_SHIFT) at local index
+ * (y & CHUNK_MASK) * CHUNK_SIZE + (x & CHUNK_MASK).
+ */
+const int CHUNK_SHIFT = 4;
+const int CHUNK_SIZE = 1 << CHUNK_SHIFT;
+const int CHUNK_MASK = CHUNK_SIZE - 1;
+const int CHUNK_CELLS = CHUNK_SIZE * CHUNK_SIZE;
+
+/* World distance kept around a camera's view when deciding what is visible,
+ * and how many chunks past that loaded chunks are retained.
+ */
+const float VIEW_MARGIN = 64;
+const int INFINITE_KEEP_MARGIN = 2;
+const int INFINITE_EVICT_INTERVAL = 60;
+
+/* Zero cells expanded per step by a reveal cascade; larger cascades carry on
+ * over the following steps. */
+const int INFINITE_FILL_BUDGET = 4096;
+
+/* Fewest mines per chunk. A cell is a zero with probability about
+ * (1 - density)^9, and zero regions only stay finite while that is below the
+ * ~0.41 threshold for 8-neighbour site percolation, i.e. density above about
+ * a tenth. 32 per chunk is one in eight. Sparser configured densities are
+ * raised to this, and the game says so when it starts.
+ */
+const int INFINITE_MIN_CHUNK_BOMBS = 32;
+
+/* Half extents of the world area cam shows. The screen size is scaled by the
+ * camera's zoom whichever way round it applies, so a zoomed out camera never
+ * loses cells at its edges. */
+float view_half_w(camera@ cam) {
+  float zoom = max(0.01, cam.zoom());
+  return cam.screen_width() / 2.0 * max(zoom, 1.0 / zoom) + VIEW_MARGIN;
+}
+
+float view_half_h(camera@ cam) {
+  float zoom = max(0.01, cam.zoom());
+  return cam.screen_height() / 2.0 * max(zoom, 1.0 / zoom) + VIEW_MARGIN;
+}
+
+class chunk {
+  int cx;
+  int cy;
+  int slot; /* Slot in chunk_map.slots */
+  bool loaded; /* In chunk_map.loaded */
+
+  /* Mines and counts are derived from the chunk seed and can be dropped and
+   * regenerated at any time. Player state is only kept in the other bitsets.
+   */
+  bool generated;
+  bitset bomb_bits;
+  nibble_array counts;
+  bool counts_ready;
+
+  bitset killed_bits;
+  bitset revealed_bits;
+  bitset marked_bits;
+
+  chunk(int cx, int cy) {
+    this.cx = cx;
+    this.cy = cy;
+    slot = -1;
+    loaded = false;
+    generated = false;
+    counts_ready = false;
+    killed_bits.resize(CHUNK_CELLS);
+    revealed_bits.resize(CHUNK_CELLS);
+    marked_bits.resize(CHUNK_CELLS);
+  }
+
+  /* Does the chunk hold any player state that can't be regenerated? */
+  bool touched() const {
+    for (uint i = 0; i < revealed_bits.words.size(); i++) {
+      if ((revealed_bits.words[i] | marked_bits.words[i]) != 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void drop_generated() {
+    generated = false;
+    counts_ready = false;
+    bomb_bits.resize(0);
+    counts.resize(0);
+  }
+}
+
+class chunk_map {
+  /* Unbounded minesweeper board made of lazily generated chunks. Every known
+   * chunk lives in a slot of `slots`, found through an int_map keyed by the
+   * packed chunk coordinate. Far away chunks are evicted; those holding player
+   * state keep their slot with their generated data dropped and regenerated
+   * when they are next needed, the rest are forgotten.
+   */
+  int_map index;
+  array<chunk@> slots;
+  array<int> free_slots;
+  array<chunk@> loaded;
+
+  uint seed;
+  int chunk_bombs;
+  int safe_x;
+  int safe_y;
+
+  chunk@ last; /* Most recently looked up chunk */
+  array<int> coords; /* Shuffle buffer used by generate */
+  pcg32 rng;
+
+  chunk_map() {
+    seed = 0;
+    chunk_bombs = 0;
+  }
+
+  void start(uint seed, int chunk_bombs, int safe_x, int safe_y) {
+    this.seed = seed;
+    this.chunk_bombs =
+        min(max(chunk_bombs, INFINITE_MIN_CHUNK_BOMBS), CHUNK_CELLS);
+    if (this.chunk_bombs != chunk_bombs) {
+      puts("infinite minesweeper: " + chunk_bombs + " mines per chunk " +
+           "raised to " + this.chunk_bombs);
+    }
+    this.safe_x = safe_x;
+    this.safe_y = safe_y;
+  }
+
+  /* Returns the chunk if it is loaded or has saved player state, otherwise
+   * null. Never generates a chunk nobody has interacted with.
+   */
+  chunk@ find(int cx, int cy) {
+    if (@last != null && last.cx == cx && last.cy == cy) {
+      return last;
+    }
+    int slot;
+    if (!index.get(pack_xy(cx, cy), slot)) {
+      return null;
+    }
+    chunk@ ch = @slots[slot];
+    if (!ch.loaded) {
+      ch.loaded = true;
+      loaded.insertLast(@ch);
+    }
+    @last = @ch;
+    return ch;
+  }
+
+  /* Returns the chunk, creating it if needed, with its mines generated. */
+  chunk@ get(int cx, int cy) {
+    chunk@ ch = @find(cx, cy);
+    if (@ch == null) {
+      @ch = @chunk(cx, cy);
+      if (free_slots.size() != 0) {
+        ch.slot = free_slots[free_slots.size() - 1];
+        free_slots.removeLast();
+        @slots[ch.slot] = @ch;
+      } else {
+        ch.slot = slots.size();
+        slots.insertLast(@ch);
+      }
+      index.set(pack_xy(cx, cy), ch.slot);
+      ch.loaded = true;
+      loaded.insertLast(@ch);
+      @last = @ch;
+    }
+    if (!ch.generated) {
+      generate(@ch);
+    }
+    return ch;
+  }
+
+  void generate(chunk@ ch) {
+    /* Places chunk_bombs mines with a partial Fisher-Yates shuffle driven by
+     * a pcg32 stream keyed by the chunk coordinate off the replay seed, so
+     * every chunk regenerates identically regardless of visiting order.
+     */
+    ch.bomb_bits.resize(CHUNK_CELLS);
+    ch.counts.resize(CHUNK_CELLS);
+    ch.counts_ready = false;
+    ch.generated = true;
+
+    coords.resize(CHUNK_CELLS);
+    for (int i = 0; i < CHUNK_CELLS; i++) {
+      coords[i] = i;
+    }
+    rng.seed(seed, (uint64(uint(ch.cx)) << 32) | uint(ch.cy));
+    for (int i = 0; i < chunk_bombs; i++) {
+      int j = i + int(rng.below(uint(CHUNK_CELLS - i)));
+      int ind = coords[j];
+      coords[j] = coords[i];
+      coords[i] = ind;
+
+      int x = (ch.cx << CHUNK_SHIFT) + (ind & CHUNK_MASK);
+      int y = (ch.cy << CHUNK_SHIFT) + (ind >> CHUNK_SHIFT);
+      if (x != safe_x || y != safe_y) {
+        ch.bomb_bits.set(ind, true);
+      }
+    }
+  }
+
+  void compute_counts(chunk@ ch) {
+    /* Counts need the mines of the surrounding chunks for border cells. */
+    array<chunk@> around(9);
+    for (int i = 0; i < 9; i++) {
+      @around[i] = @get(ch.cx + i % 3 - 1, ch.cy + i / 3 - 1);
+    }
+    for (int ly = 0; ly < CHUNK_SIZE; ly++) {
+      for (int lx = 0; lx < CHUNK_SIZE; lx++) {
+        int cnt = 0;
+        for (int i = 0; i < 8; i++) {
+          int nx = lx + dc[i] + CHUNK_SIZE;
+          int ny = ly + dr[i] + CHUNK_SIZE;
+          chunk@ nch = @around[(ny >> CHUNK_SHIFT) * 3 + (nx >> CHUNK_SHIFT)];
+          if (nch.bomb_bits.get((ny & CHUNK_MASK) * CHUNK_SIZE + (nx & CHUNK_MASK))) {
+            cnt++;
+          }
+        }
+        ch.counts.set(ly * CHUNK_SIZE + lx, cnt);
+      }
+    }
+    ch.counts_ready = true;
+    @last = @ch;
+  }
+
+  int local(int x, int y) const {
+    return (y & CHUNK_MASK) * CHUNK_SIZE + (x & CHUNK_MASK);
+  }
+
+  chunk@ at(int x, int y) {
+    return get(x >>> CHUNK_SHIFT, y >>> CHUNK_SHIFT);
+  }
+
+  bool bomb(int x, int y) { return at(x, y).bomb_bits.get(local(x, y)); }
+
+  bool killed(int x, int y) { return at(x, y).killed_bits.get(local(x, y)); }
+  void killed(int x, int y, bool val) { at(x, y).killed_bits.set(local(x, y), val); }
+
+  bool revealed(int x, int y) { return at(x, y).revealed_bits.get(local(x, y)); }
+  void revealed(int x, int y, bool val) { at(x, y).revealed_bits.set(local(x, y), val); }
+
+  bool marked(int x, int y) { return at(x, y).marked_bits.get(local(x, y)); }
+  void marked(int x, int y, bool val) { at(x, y).marked_bits.set(local(x, y), val); }
+
+  int bomb_count(int x, int y) {
+    chunk@ ch = @at(x, y);
+    if (!ch.counts_ready) {
+      compute_counts(@ch);
+    }
+    return ch.counts.get(local(x, y));
+  }
+
+  /* Returns true if (cx, cy) is within margin chunks of one of the chunk
+   * ranges in keep, given as min_cx, min_cy, max_cx, max_cy. */
+  bool kept(int cx, int cy, array<int>@ keep, int margin) const {
+    for (uint i = 0; i < keep.size(); i += 4) {
+      if (keep[i] - margin <= cx && cx <= keep[i + 2] + margin &&
+          keep[i + 1] - margin <= cy && cy <= keep[i + 3] + margin) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void evict(array<int>@ keep, int margin) {
+    /* Drops every loaded chunk outside of all the given chunk ranges. */
+    for (uint i = 0; i < loaded.size(); i++) {
+      chunk@ ch = @loaded[i];
+      if (kept(ch.cx, ch.cy, @keep, margin)) {
+        continue;
+      }
+      ch.loaded = false;
+      if (ch.touched()) {
+        ch.drop_generated();
+      } else {
+        index.remove(pack_xy(ch.cx, ch.cy));
+        @slots[ch.slot] = null;
+        free_slots.insertLast(ch.slot);
+      }
+      @loaded[i] = @loaded[loaded.size() - 1];
+      loaded.removeLast();
+      i--;
+    }
+    @last = null;
+  }
+}
+
+class infinite_minesweeper : enemy_base {
+  /* Minesweeper controllable on an unbounded board. Cell (0, 0) has its top
+   * left corner at the entity position. There is no win condition; the
+   * counter shows the number of revealed cells.
+   */
+  int chunk_bombs;
+  int marks; /* count of number of marked cells */
+  float tile_size;
+
+  bool grid_ready;
+  chunk_map grid;
+  array<int> fill_x; /* BFS queue of cells revealed by the current reveal */
+  array<int> fill_y;
+  uint fill_pos; /* Next queued cell to expand */
+
+  int reveal_count; /* Number of cells that have been revealed */
+  bool dead; /* Set when the player reveals a mine */
+
+  scene@ g;
+  script@ s;
+  scriptenemy@ self;
+  canvas@ cvs;
+  canvas@ hud;
+  textfield@ counter_txt;
+  int counter_value;
+  array<textfield@> count_txts;
+
+  single_sprite@ flag;
+  single_sprite@ bomb;
+
+  array<int> views; /* Cells each camera can see as x0, y0, x1, y1 */
+  array<int> view_chunks; /* The same ranges in chunks, for eviction */
+
+  int lock_out_timer; /* Timer at the start after spawning locking out inputs */
+  int evict_timer;
+  int last_mouse_st; /* The mouse state from the last time step() was called */
+  int last_x; /* (last_x, last_y) give the cell under the mouse last step */
+  int last_y;
+
+  infinite_minesweeper(int chunk_bombs, float tile_size) {
+    this.chunk_bombs = chunk_bombs;
+    this.tile_size = tile_size;
+    @g = @get_scene();
+  }
+
+  void init(script@ s, scriptenemy@ self) {
+    @this.s = @s;
+    @this.self = @self;
+    @cvs = create_canvas(false, self.layer(), 1);
+    @hud = create_canvas(true, 10, 1);
+    @counter_txt = @make_text(0xFFFFFFFF);
+    counter_value = reveal_count;
+    counter_txt.text("" + counter_value);
+    count_txts.resize(9);
+    for (int count = 1; count <= 8; count++) {
+      @count_txts[count] = @make_text(COLOR_COUNTS[count]);
+      count_txts[count].text("" + count);
+    }
+    @flag = @single_sprite("flag", "cidle", 1, 1);
+    @bomb = @single_sprite("editor", "skull", 0, 1);
+
+    grid_ready = false;
+    fill_pos = 0;
+    lock_out_timer = 55;
+    evict_timer = INFINITE_EVICT_INTERVAL;
+  }
+
+  void step() {
+    if (dead) {
+      return;
+    }
+    if (lock_out_timer > 0) {
+      lock_out_timer--;
+      return;
+    }
+    if (grid_ready && --evict_timer <= 0) {
+      evict_timer = INFINITE_EVICT_INTERVAL;
+      evict_far_chunks();
+    }
+    handle_input();
+    expand_fill();
+  }
+
+  void handle_input() {
+    int player = self.player_index();
+    if (player == -1) {
+      last_mouse_st = 0;
+      return;
+    }
+
+    int layer = self.layer();
+    float x = g.mouse_x_world(player, layer);
+    float y = g.mouse_y_world(player, layer);
+    int mst = g.mouse_state(player);
+
+    last_x = int(floor((x - self.x()) / tile_size));
+    last_y = int(floor((y - self.y()) / tile_size));
+
+    /* Nothing exists to mark until the first reveal seeds the board. */
+    if (grid_ready && (mst & RIGHT_CLICK) != 0 && (last_mouse_st & RIGHT_CLICK) == 0) {
+      // pos-edge right click
+      if (!grid.revealed(last_x, last_y)) {
+        bool marked = !grid.marked(last_x, last_y);
+        grid.marked(last_x, last_y, marked);
+        marks += marked ? 1 : -1;
+      }
+    }
+
+    bool left_click = (mst & LEFT_CLICK) == 0 && (last_mouse_st & LEFT_CLICK) != 0;
+    bool middle_click = (mst & MIDDLE_CLICK) == 0 && (last_mouse_st & MIDDLE_CLICK) != 0;
+    last_mouse_st = mst;
+    if (!left_click && !middle_click) {
+      return;
+    }
+
+    if (!grid_ready) {
+      if (!left_click || !s.rrnd.seed_set()) {
+        return;
+      }
+      grid.start(s.rrnd.seed, chunk_bombs, last_x, last_y);
+      grid_ready = true;
+    }
+
+    if (grid.marked(last_x, last_y)) {
+      return;
+    }
+    if (grid.revealed(last_x, last_y)) {
+      /* left/middle clicking a revealed cell reveals all its neighbors if
+       * the right number of them are marked. */
+      int cnt = 0;
+      for (int i = 0; i < 8; i++) {
+        if (grid.marked(last_x + dc[i], last_y + dr[i])) {
+          cnt++;
+        }
+      }
+      if (cnt == grid.bomb_count(last_x, last_y)) {
+        for (int i = 0; i < 8; i++) {
+          int nx = last_x + dc[i];
+          int ny = last_y + dr[i];
+          if (!grid.marked(nx, ny)) {
+            reveal_cell(nx, ny);
+          }
+        }
+      }
+    } else if (left_click) {
+      reveal_cell(last_x, last_y);
+    }
+  }
+
+  void expand_fill() {
+    /* Expand out from any revealed cell with no neighbouring mines. Cells are
+     * marked revealed as they are queued so each is queued at most once, and
+     * the fill freely crosses chunk boundaries. At most INFINITE_FILL_BUDGET
+     * cells are expanded per step; the rest of the queue waits for the next.
+     */
+    int budget = INFINITE_FILL_BUDGET;
+    while (fill_pos < fill_x.size() && budget > 0 && !dead) {
+      int cx = fill_x[fill_pos];
+      int cy = fill_y[fill_pos];
+      fill_pos++;
+      budget--;
+      if (grid.bomb_count(cx, cy) != 0) {
+        continue;
+      }
+      for (int j = 0; j < 8; j++) {
+        reveal_cell(cx + dc[j], cy + dr[j]);
+      }
+    }
+    if (fill_pos == fill_x.size()) {
+      fill_x.resize(0);
+      fill_y.resize(0);
+      fill_pos = 0;
+    }
+  }
+
+  void reveal_cell(int x, int y) {
+    if (grid.revealed(x, y)) {
+      return;
+    }
+    grid.revealed(x, y, true);
+    reveal_count++;
+    if (grid.bomb(x, y)) {
+      dead = true;
+      grid.killed(x, y, true);
+    }
+    fill_x.insertLast(x);
+    fill_y.insertLast(y);
+  }
+
+  void evict_far_chunks() {
+    /* Chunks near any camera are kept. With no camera to go by nothing is
+     * evicted. */
+    update_views(self.x(), self.y());
+    if (views.size() == 0) {
+      return;
+    }
+    view_chunks.resize(views.size());
+    for (uint i = 0; i < views.size(); i++) {
+      view_chunks[i] = views[i] >>> CHUNK_SHIFT;
+    }
+    grid.evict(@view_chunks, INFINITE_KEEP_MARGIN);
+  }
+
+  void update_views(float ent_x, float ent_y) {
+    /* Collects the range of cells each camera can see. The canvas is shown
+     * on every camera, so every view has to be drawn. */
+    views.resize(0);
+    for (int i = 0; i < int(num_cameras()); i++) {
+      camera@ cam = @get_camera(i);
+      if (@cam == null) {
+        continue;
+      }
+      float half_w = view_half_w(cam);
+      float half_h = view_half_h(cam);
+      views.insertLast(int(floor((cam.x() - half_w - ent_x) / tile_size)));
+      views.insertLast(int(floor((cam.y() - half_h - ent_y) / tile_size)));
+      views.insertLast(int(floor((cam.x() + half_w - ent_x) / tile_size)));
+      views.insertLast(int(floor((cam.y() + half_h - ent_y) / tile_size)));
+    }
+  }
+
+  /* Returns true if (x, y) is in one of the views before view k, so cells
+   * several cameras see are drawn once. */
+  bool seen_before(int x, int y, uint k) const {
+    for (uint i = 0; i < k; i += 4) {
+      if (views[i] <= x && x <= views[i + 2] &&
+          views[i + 1] <= y && y <= views[i + 3]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void draw(float) {
+    float ent_x = self.x();
+    float ent_y = self.y();
+
+    cvs.reset();
+    cvs.layer(self.layer());
+    cvs.multiply(tile_size, 0, 0, tile_size, ent_x, ent_y);
+
+    if (counter_value != reveal_count) {
+      counter_value = reveal_count;
+      counter_txt.text("" + counter_value);
+    }
+    hud.draw_text(@counter_txt, 0, -400, 1, 1, 0);
+
+    /* Work out the range of cells near each camera. */
+    update_views(ent_x, ent_y);
+
+    chunk@ last_ch = grid_ready ? @grid.find(last_x >>> CHUNK_SHIFT, last_y >>> CHUNK_SHIFT) : null;
+    bool on_revealed_cell = @last_ch != null &&
+        last_ch.revealed_bits.get(grid.local(last_x, last_y));
+    bool pressing = (last_mouse_st & LEFT_CLICK) != 0 || (
+      on_revealed_cell && (last_mouse_st & MIDDLE_CLICK) != 0
+    );
+
+    /* Cells in chunks nobody has interacted with are always unrevealed and
+     * unmarked, so they are drawn without generating their chunk.
+     */
+    cvs.sub_layer(1);
+    for (uint k = 0; k < views.size(); k += 4) {
+      for (int y = views[k + 1]; y <= views[k + 3]; y++) {
+        for (int x = views[k]; x <= views[k + 2]; x++) {
+          if (seen_before(x, y, k)) {
+            continue;
+          }
+          chunk@ ch = grid_ready ? @grid.find(x >>> CHUNK_SHIFT, y >>> CHUNK_SHIFT) : null;
+          int ind = grid.local(x, y);
+          bool revealed = @ch != null && ch.revealed_bits.get(ind);
+
+          int bg = CELL_BG_UNPRESSED;
+          if (revealed || (dead && @ch != null)) {
+            bg = CELL_BG_REVEALED;
+          } else if (pressing && ((x == last_x && y == last_y) || (on_revealed_cell &&
+                     abs(x - last_x) <= 1 && abs(y - last_y) <= 1))) {
+            bg = CELL_BG_PRESSED;
+          }
+          draw_cell_bg(@cvs, x, y, bg);
+        }
+      }
+    }
+
+    if (!grid_ready) {
+      return;
+    }
+    for (uint k = 0; k < views.size(); k += 4) {
+      for (int y = views[k + 1]; y <= views[k + 3]; y++) {
+        for (int x = views[k]; x <= views[k + 2]; x++) {
+          if (!seen_before(x, y, k)) {
+            draw_cell_overlay(x, y);
+          }
+        }
+      }
+    }
+  }
+
+  void draw_cell_overlay(int x, int y) {
+    chunk@ ch = @grid.find(x >>> CHUNK_SHIFT, y >>> CHUNK_SHIFT);
+    if (@ch == null) {
+      return;
+    }
+    int ind = grid.local(x, y);
+    if (!ch.revealed_bits.get(ind) && !dead) {
+      if (ch.marked_bits.get(ind)) {
+        cvs.sub_layer(1);
+        flag.draw(@cvs, x + 0.5, y + 0.5, 0.35);
+      }
+      return;
+    }
+    if (!ch.generated) {
+      grid.generate(@ch);
+    }
+    if (ch.bomb_bits.get(ind)) {
+      cvs.sub_layer(1);
+      bomb.draw(@cvs, x + 0.5, y + 0.5, 0.35, 0,
+                ch.killed_bits.get(ind) ? 0xFFFF7777 : 0xFFFFFFFF);
+    } else {
+      int count = grid.bomb_count(x, y);
+      if (count != 0) {
+        float txt_scale = 0.8 / 36.0;
+        cvs.sub_layer(1 + count);
+        cvs.draw_text(@count_txts[count], x + 0.5, y + 0.5,
+                      txt_scale, txt_scale, 0);
+      }
+    }
+  }
+}
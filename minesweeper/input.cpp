@@ -0,0 +1,138 @@
+interface minesweeper_input {
+  /* Reports the mouse for this step. x and y are in board cell units with
+   * (0, 0) the top left corner of the board. Returns false if there's no
+   * input this step.
+   */
+  bool poll(minesweeper@ ms, int &out mouse_state, float &out x, float &out y);
+}
+
+class scene_input : minesweeper_input {
+  /* Reads the mouse of the player controlling the minesweeper entity. */
+  scene@ g;
+
+  scene_input() {
+    @g = @get_scene();
+  }
+
+  bool poll(minesweeper@ ms, int &out mouse_state, float &out x, float &out y) {
+    int player = ms.self.player_index();
+    if (player == -1) {
+      return false;
+    }
+    float lft = ms.self.x() - ms.cols / 2.0 * ms.tile_size;
+    float top = ms.self.y() - ms.rows / 2.0 * ms.tile_size;
+    int layer = ms.self.layer();
+    x = (g.mouse_x_world(player, layer) - lft) / ms.tile_size;
+    y = (g.mouse_y_world(player, layer) - top) / ms.tile_size;
+    mouse_state = g.mouse_state(player);
+    return true;
+  }
+}
+
+class input_log {
+  /* Sequence of input events. Each event holds from its frame until the
+   * next event's frame. Frames count polls, i.e. steps after the initial
+   * lock out.
+   */
+  uint seed;
+  array<int> frames;
+  array<int> states;
+  array<float> xs;
+  array<float> ys;
+
+  input_log() {
+    seed = 0;
+  }
+
+  uint size() const {
+    return frames.size();
+  }
+
+  int last_frame() const {
+    return frames.size() == 0 ? -1 : frames[frames.size() - 1];
+  }
+
+  void add(int frame, int mouse_state, float x, float y) {
+    frames.insertLast(frame);
+    states.insertLast(mouse_state);
+    xs.insertLast(x);
+    ys.insertLast(y);
+  }
+
+  /* Writes the log out as script source that rebuilds it, for pasting into
+   * a benchmark. */
+  string to_string() const {
+    string res = "log.seed = " + seed + ";\n";
+    for (uint i = 0; i < frames.size(); i++) {
+      res += "log.add(" + frames[i] + ", " + states[i] + ", " +
+             xs[i] + ", " + ys[i] + ");\n";
+    }
+    return res;
+  }
+}
+
+class recording_input : minesweeper_input {
+  /* Passes through another input, logging an event whenever the mouse state
+   * or the cell under the mouse changes.
+   */
+  minesweeper_input@ inner;
+  input_log log;
+  int frame;
+  int last_state;
+  int last_r;
+  int last_c;
+
+  recording_input(minesweeper_input@ inner) {
+    @this.inner = @inner;
+    frame = 0;
+    last_state = -1;
+  }
+
+  bool poll(minesweeper@ ms, int &out mouse_state, float &out x, float &out y) {
+    if (!inner.poll(@ms, mouse_state, x, y)) {
+      return false;
+    }
+    int r = int(floor(y));
+    int c = int(floor(x));
+    if (mouse_state != last_state || r != last_r || c != last_c) {
+      log.add(frame, mouse_state, x, y);
+      last_state = mouse_state;
+      last_r = r;
+      last_c = c;
+    }
+    frame++;
+    return true;
+  }
+}
+
+class scripted_input : minesweeper_input {
+  /* Plays back an input_log one frame per poll. */
+  input_log@ log;
+  int frame;
+  uint next;
+  int state;
+  float x;
+  float y;
+
+  scripted_input(input_log@ log) {
+    @this.log = @log;
+    frame = 0;
+    next = 0;
+    state = 0;
+    x = y = -1;
+  }
+
+  bool poll(minesweeper@ ms, int &out mouse_state, float &out x, float &out y) {
+    while (next < log.size() && log.frames[next] <= frame) {
+      state = log.states[next];
+      this.x = log.xs[next];
+      this.y = log.ys[next];
+      next++;
+    }
+    frame++;
+    mouse_state = state;
+    x = this.x;
+    y = this.y;
+    return true;
+  }
+}
@@ -0,0 +1,478 @@
+#include "board.cpp"
+#include "../utils/random.cpp"
+#include "../utils/job_scheduler.cpp"
+
+/* Largest frontier component solved by brute force enumeration. */
+const int NO_GUESS_ENUM_LIMIT = 10;
+
+/* Candidate layouts tried before settling for the last one generated. */
+const int NO_GUESS_MAX_CANDIDATES = 500;
+
+int popcount(uint x) {
+  x = x - ((x >> 1) & 0x55555555);
+  x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+  x = (x + (x >> 4)) & 0x0F0F0F0F;
+  return int((x * 0x01010101) >> 24);
+}
+
+class no_guess_generator : job {
+  /* Produces a layout that can be solved from the first click without ever
+   * guessing. Candidate layouts are drawn from rng and played out by a
+   * solver using, in order, the single cell rules, the pairwise subset rule
+   * and brute force enumeration of small frontier components. The first
+   * candidate the solver clears is accepted.
+   *
+   * Work is done in small units by run() so generation can be spread over
+   * several frames. The accepted layout only depends on the rng stream,
+   * never on how the work was sliced, so it is reproduced in replays.
+   */
+  int rows;
+  int cols;
+  int bombs;
+  int first; /* Index of the first clicked cell */
+  pcg32@ rng;
+
+  board cand; /* revealed = proven safe, marked = proven mine */
+  array<int> allowed; /* Cells a mine may be placed in */
+  array<int> swaps;
+  int safe_total;
+  int revealed_safe;
+  int candidates;
+
+  bool solving;
+  bool done;
+
+  array<int> pending; /* Revealed cells whose constraint should be rechecked */
+  bitset queued;
+  array<int> cascade;
+
+  /* Enumeration scratch */
+  bitset comp_seen;
+  array<int> comp_cells;
+  array<int> comp_cons;
+  array<uint> con_masks;
+  array<int> con_rems;
+
+  no_guess_generator(int rows, int cols, int bombs, int first_r, int first_c,
+                     pcg32@ rng) {
+    @this.rng = @rng;
+    this.rows = rows;
+    this.cols = cols;
+    cand.resize(rows, cols);
+    queued.resize(rows * cols);
+    comp_seen.resize(rows * cols);
+    first = cand.index(first_r, first_c);
+
+    /* Keep the first click and its neighbours clear so it always opens up,
+     * unless the board is too dense for that. */
+    for (int r = 0; r < rows; r++) {
+      for (int c = 0; c < cols; c++) {
+        if (abs(r - first_r) > 1 || abs(c - first_c) > 1) {
+          allowed.insertLast(cand.index(r, c));
+        }
+      }
+    }
+    if (bombs > int(allowed.size())) {
+      allowed.resize(0);
+      for (int i = 0; i < rows * cols; i++) {
+        if (i != first) {
+          allowed.insertLast(i);
+        }
+      }
+    }
+    this.bombs = min(bombs, int(allowed.size()));
+    safe_total = rows * cols - this.bombs;
+
+    candidates = 0;
+    solving = false;
+    done = false;
+  }
+
+  /* Draws a candidate or takes a solver step per unit of budget until the
+   * layout is finished. Returns true once the layout is ready. */
+  bool run(int &inout budget) {
+    while (!done && budget > 0) {
+      if (!solving) {
+        new_candidate();
+      } else {
+        solve_step();
+      }
+      budget--;
+    }
+    return done;
+  }
+
+  /* Places the accepted mines on the real board. */
+  void apply(board@ grid) {
+    for (int i = 0; i < rows * cols; i++) {
+      if (cand.bomb(i)) {
+        grid.add_bomb(i);
+      }
+    }
+  }
+
+  void new_candidate() {
+    cand.clear();
+    int n = int(allowed.size());
+    swaps.resize(bombs);
+    for (int i = 0; i < bombs; i++) {
+      int j = i + int(rng.below(uint(n - i)));
+      int ind = allowed[j];
+      allowed[j] = allowed[i];
+      allowed[i] = ind;
+      swaps[i] = j;
+      cand.add_bomb(ind);
+    }
+    for (int i = bombs - 1; i >= 0; i--) {
+      int j = swaps[i];
+      int tmp = allowed[j];
+      allowed[j] = allowed[i];
+      allowed[i] = tmp;
+    }
+    candidates++;
+
+    for (uint i = 0; i < pending.size(); i++) {
+      queued.set(pending[i], false);
+    }
+    pending.resize(0);
+    revealed_safe = 0;
+    solving = true;
+    reveal(first);
+
+    if (candidates >= NO_GUESS_MAX_CANDIDATES) {
+      puts("no-guess generation gave up after " + candidates + " candidates");
+      done = true;
+    }
+  }
+
+  void solve_step() {
+    if (revealed_safe == safe_total) {
+      done = true;
+      return;
+    }
+    if (pending.size() != 0) {
+      int ind = pending[pending.size() - 1];
+      pending.removeLast();
+      queued.set(ind, false);
+      check_cell(ind);
+      return;
+    }
+    if (!apply_global_rule() && !enumerate()) {
+      /* Stuck, this layout would need a guess. */
+      solving = false;
+    }
+  }
+
+  bool unknown(int ind) {
+    return !cand.revealed(ind) && !cand.marked(ind);
+  }
+
+  void enqueue(int ind) {
+    if (cand.revealed(ind) && !queued.get(ind)) {
+      queued.set(ind, true);
+      pending.insertLast(ind);
+    }
+  }
+
+  void enqueue_around(int ind) {
+    int r = ind / cols;
+    int c = ind % cols;
+    for (int i = 0; i < 8; i++) {
+      if (cand.in_bounds(r + dr[i], c + dc[i])) {
+        enqueue(cand.index(r + dr[i], c + dc[i]));
+      }
+    }
+  }
+
+  void reveal(int ind) {
+    if (cand.revealed(ind)) {
+      return;
+    }
+    cascade.resize(0);
+    cascade.insertLast(ind);
+    while (cascade.size() != 0) {
+      int cur = cascade[cascade.size() - 1];
+      cascade.removeLast();
+      if (cand.revealed(cur) || cand.marked(cur)) {
+        continue;
+      }
+      cand.revealed(cur, true);
+      revealed_safe++;
+      enqueue(cur);
+      enqueue_around(cur);
+      if (cand.bomb_count(cur) == 0) {
+        int r = cur / cols;
+        int c = cur % cols;
+        for (int i = 0; i < 8; i++) {
+          if (cand.in_bounds(r + dr[i], c + dc[i])) {
+            cascade.insertLast(cand.index(r + dr[i], c + dc[i]));
+          }
+        }
+      }
+    }
+  }
+
+  void mark(int ind) {
+    if (cand.marked(ind)) {
+      return;
+    }
+    cand.marked(ind, true);
+    enqueue_around(ind);
+  }
+
+  /* Unknown neighbours of ind as a mask over its 3x3 window, bit
+   * (dr + 1) * 3 + (dc + 1). */
+  uint unknown_mask(int ind) {
+    int r = ind / cols;
+    int c = ind % cols;
+    uint mask = 0;
+    for (int i = 0; i < 8; i++) {
+      int nr = r + dr[i];
+      int nc = c + dc[i];
+      if (cand.in_bounds(nr, nc) && unknown(cand.index(nr, nc))) {
+        mask |= uint(1) << ((dr[i] + 1) * 3 + dc[i] + 1);
+      }
+    }
+    return mask;
+  }
+
+  /* Mines around ind not yet proven. */
+  int remaining(int ind) {
+    int r = ind / cols;
+    int c = ind % cols;
+    int rem = cand.bomb_count(ind);
+    for (int i = 0; i < 8; i++) {
+      int nr = r + dr[i];
+      int nc = c + dc[i];
+      if (cand.in_bounds(nr, nc) && cand.marked(cand.index(nr, nc))) {
+        rem--;
+      }
+    }
+    return rem;
+  }
+
+  /* Applies val (true = mine) to the cells in the 3x3 window of ind set in
+   * mask. */
+  void resolve_mask(int ind, uint mask, bool mine) {
+    int r = ind / cols;
+    int c = ind % cols;
+    for (int bit = 0; bit < 9; bit++) {
+      if ((mask & (uint(1) << bit)) == 0) {
+        continue;
+      }
+      int cell = cand.index(r + bit / 3 - 1, c + bit % 3 - 1);
+      if (mine) {
+        mark(cell);
+      } else {
+        reveal(cell);
+      }
+    }
+  }
+
+  void check_cell(int a) {
+    uint mask_a = unknown_mask(a);
+    if (mask_a == 0) {
+      return;
+    }
+    int rem_a = remaining(a);
+    int cnt_a = popcount(mask_a);
+    if (rem_a == 0) {
+      resolve_mask(a, mask_a, false);
+      return;
+    }
+    if (rem_a == cnt_a) {
+      resolve_mask(a, mask_a, true);
+      return;
+    }
+
+    /* Subset rule against every revealed cell within two of a. With `common`
+     * the shared unknowns, mines(only_b) - mines(only_a) = rem_b - rem_a, so
+     * a difference equal to either side's size settles both sides.
+     */
+    int ar = a / cols;
+    int ac = a % cols;
+    for (int br = max(0, ar - 2); br <= min(rows - 1, ar + 2); br++) {
+      for (int bc = max(0, ac - 2); bc <= min(cols - 1, ac + 2); bc++) {
+        int b = cand.index(br, bc);
+        if (b == a || !cand.revealed(b)) {
+          continue;
+        }
+        uint common = 0;
+        uint only_b = 0;
+        for (int i = 0; i < 8; i++) {
+          int nr = br + dr[i];
+          int nc = bc + dc[i];
+          if (!cand.in_bounds(nr, nc) || !unknown(cand.index(nr, nc))) {
+            continue;
+          }
+          if (abs(nr - ar) <= 1 && abs(nc - ac) <= 1) {
+            common |= uint(1) << ((nr - ar + 1) * 3 + nc - ac + 1);
+          } else {
+            only_b |= uint(1) << ((dr[i] + 1) * 3 + dc[i] + 1);
+          }
+        }
+        if (common == 0) {
+          continue;
+        }
+        uint only_a = mask_a & ~common;
+        int d = remaining(b) - rem_a;
+        if (d == popcount(only_b) && (only_a | only_b) != 0) {
+          resolve_mask(b, only_b, true);
+          resolve_mask(a, only_a, false);
+          return;
+        }
+        if (-d == popcount(only_a) && (only_a | only_b) != 0) {
+          resolve_mask(a, only_a, true);
+          resolve_mask(b, only_b, false);
+          return;
+        }
+      }
+    }
+  }
+
+  bool apply_global_rule() {
+    /* When the remaining mine count pins down every unknown cell. */
+    int mines_left = bombs;
+    int unknown_left = 0;
+    for (int i = 0; i < rows * cols; i++) {
+      if (cand.marked(i)) {
+        mines_left--;
+      } else if (!cand.revealed(i)) {
+        unknown_left++;
+      }
+    }
+    if (unknown_left == 0 || (mines_left != 0 && mines_left != unknown_left)) {
+      return false;
+    }
+    for (int i = 0; i < rows * cols; i++) {
+      if (unknown(i)) {
+        if (mines_left == 0) {
+          reveal(i);
+        } else {
+          mark(i);
+        }
+      }
+    }
+    return true;
+  }
+
+  bool enumerate() {
+    /* Splits the unknown frontier cells into components linked through shared
+     * constraints and brute forces every component of at most
+     * NO_GUESS_ENUM_LIMIT cells. A cell that is a mine in every consistent
+     * assignment, or in none, is resolved.
+     */
+    bool progress = false;
+    comp_seen.clear();
+    for (int start = 0; start < rows * cols && !progress; start++) {
+      if (comp_seen.get(start) || !unknown(start) || !on_frontier(start)) {
+        continue;
+      }
+      collect_component(start);
+      if (int(comp_cells.size()) > NO_GUESS_ENUM_LIMIT) {
+        continue;
+      }
+      progress = solve_component();
+    }
+    return progress;
+  }
+
+  bool on_frontier(int ind) {
+    int r = ind / cols;
+    int c = ind % cols;
+    for (int i = 0; i < 8; i++) {
+      int nr = r + dr[i];
+      int nc = c + dc[i];
+      if (cand.in_bounds(nr, nc) && cand.revealed(cand.index(nr, nc))) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void collect_component(int start) {
+    comp_cells.resize(0);
+    comp_cons.resize(0);
+    comp_seen.set(start, true);
+    comp_cells.insertLast(start);
+    for (uint i = 0; i < comp_cells.size(); i++) {
+      int r = comp_cells[i] / cols;
+      int c = comp_cells[i] % cols;
+      for (int j = 0; j < 8; j++) {
+        int nr = r + dr[j];
+        int nc = c + dc[j];
+        if (!cand.in_bounds(nr, nc)) {
+          continue;
+        }
+        int con = cand.index(nr, nc);
+        if (!cand.revealed(con) || comp_seen.get(con)) {
+          continue;
+        }
+        comp_seen.set(con, true);
+        comp_cons.insertLast(con);
+        for (int k = 0; k < 8; k++) {
+          int ur = nr + dr[k];
+          int uc = nc + dc[k];
+          if (!cand.in_bounds(ur, uc)) {
+            continue;
+          }
+          int u = cand.index(ur, uc);
+          if (unknown(u) && !comp_seen.get(u)) {
+            comp_seen.set(u, true);
+            comp_cells.insertLast(u);
+          }
+        }
+      }
+    }
+  }
+
+  bool solve_component() {
+    /* Each constraint becomes a mask over the component's cells. */
+    int k = int(comp_cells.size());
+    con_masks.resize(comp_cons.size());
+    con_rems.resize(comp_cons.size());
+    for (uint i = 0; i < comp_cons.size(); i++) {
+      int con = comp_cons[i];
+      uint mask = 0;
+      for (int j = 0; j < k; j++) {
+        int cell = comp_cells[j];
+        if (abs(cell / cols - con / cols) <= 1 && abs(cell % cols - con % cols) <= 1) {
+          mask |= uint(1) << j;
+        }
+      }
+      con_masks[i] = mask;
+      con_rems[i] = remaining(con);
+    }
+
+    uint any_mine = 0;
+    uint all_mine = (uint(1) << k) - 1;
+    bool found = false;
+    for (uint assign = 0; assign < (uint(1) << k); assign++) {
+      bool ok = true;
+      for (uint i = 0; i < con_masks.size() && ok; i++) {
+        ok = popcount(assign & con_masks[i]) == con_rems[i];
+      }
+      if (ok) {
+        found = true;
+        any_mine |= assign;
+        all_mine &= assign;
+      }
+    }
+    if (!found) {
+      return false;
+    }
+
+    bool progress = false;
+    for (int j = 0; j < k; j++) {
+      uint bit = uint(1) << j;
+      if ((any_mine & bit) == 0) {
+        reveal(comp_cells[j]);
+        progress = true;
+      } else if ((all_mine & bit) != 0) {
+        mark(comp_cells[j]);
+        progress = true;
+      }
+    }
+    return progress;
+  }
+}
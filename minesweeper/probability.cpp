@@ -0,0 +1,405 @@
+#include "board.cpp"
+
+/* Largest frontier component the overlay enumerates. Cells of larger
+ * components are treated like any other cell away from the frontier when
+ * combining, and their component is left with enumerated unset.
+ */
+const int PROB_ENUM_LIMIT = 16;
+
+class prob_component {
+  /* A set of unknown frontier cells linked through shared constraints.
+   * sol[m] is the share of the component's consistent assignments that place
+   * m mines and cell_mine[j * (k + 1) + m] the share of those that also put a
+   * mine on cells[j], where k = cells.size(). prob[j] is -1 when no mine
+   * count is consistent with the rest of the board.
+   */
+  array<int> cells;
+  array<int> cons;
+  bool enumerated; /* False when larger than PROB_ENUM_LIMIT */
+  bool valid; /* Enumerated and consistent with the flags */
+  array<double> sol;
+  array<double> cell_mine;
+  array<float> prob; /* Final mine probability of each cell */
+
+  prob_component() {
+    enumerated = false;
+    valid = false;
+  }
+}
+
+class probability_overlay {
+  /* Maintains the exact mine probability of every unknown frontier cell.
+   * Flagged cells are taken to be mines. The frontier is split into
+   * independent components that are enumerated separately and cached; only
+   * components near cells changed by a step are rebuilt. Combining the cached
+   * per-component tables with the mine count left for the rest of the board
+   * is cheap and done on every update.
+   */
+  board@ grid;
+  int rows;
+  int cols;
+  int bombs;
+
+  array<int> comp_of; /* Component slot of each cell, -1 if none */
+  array<prob_component@> comps;
+  array<int> free_slots;
+  float rest_prob; /* Probability for unknown cells off the frontier */
+
+  bitset seen;
+  array<int> seen_list;
+  array<int> reseed;
+
+  /* Enumeration scratch */
+  array<array<int> > cell_cons;
+  array<int> con_rem;
+  array<int> con_left;
+  array<bool> assign;
+
+  void reset(board@ grid, int bombs) {
+    @this.grid = @grid;
+    rows = grid.rows;
+    cols = grid.cols;
+    this.bombs = bombs;
+    comp_of.resize(rows * cols);
+    for (int i = 0; i < rows * cols; i++) {
+      comp_of[i] = -1;
+    }
+    comps.resize(0);
+    free_slots.resize(0);
+    seen.resize(rows * cols);
+    rest_prob = 0;
+  }
+
+  bool unknown(int ind) {
+    return !grid.revealed(ind) && !grid.marked(ind);
+  }
+
+  /* Returns the mine probability of an unknown frontier cell or -1. */
+  float probability(int ind) {
+    int slot = comp_of[ind];
+    if (slot == -1 || !comps[slot].valid) {
+      return -1;
+    }
+    prob_component@ comp = @comps[slot];
+    for (uint j = 0; j < comp.cells.size(); j++) {
+      if (comp.cells[j] == ind) {
+        return comp.prob[j];
+      }
+    }
+    return -1;
+  }
+
+  void update(array<int>@ changed, int marks) {
+    /* Drop every component within two cells of a change; a reveal or flag
+     * alters constraints covering unknowns up to that far away. */
+    reseed.resize(0);
+    for (uint i = 0; i < changed.size(); i++) {
+      int r = changed[i] / cols;
+      int c = changed[i] % cols;
+      for (int nr = max(0, r - 2); nr <= min(rows - 1, r + 2); nr++) {
+        for (int nc = max(0, c - 2); nc <= min(cols - 1, c + 2); nc++) {
+          int ind = grid.index(nr, nc);
+          drop_component(comp_of[ind]);
+          reseed.insertLast(ind);
+        }
+      }
+    }
+
+    for (uint i = 0; i < reseed.size(); i++) {
+      int ind = reseed[i];
+      if (comp_of[ind] == -1 && unknown(ind) && on_frontier(ind)) {
+        build_component(ind);
+      }
+    }
+    combine(bombs - marks);
+  }
+
+  void drop_component(int slot) {
+    if (slot == -1) {
+      return;
+    }
+    prob_component@ comp = @comps[slot];
+    for (uint j = 0; j < comp.cells.size(); j++) {
+      comp_of[comp.cells[j]] = -1;
+      reseed.insertLast(comp.cells[j]);
+    }
+    @comps[slot] = null;
+    free_slots.insertLast(slot);
+  }
+
+  bool on_frontier(int ind) {
+    int r = ind / cols;
+    int c = ind % cols;
+    for (int i = 0; i < 8; i++) {
+      int nr = r + dr[i];
+      int nc = c + dc[i];
+      if (grid.in_bounds(nr, nc) && grid.revealed(grid.index(nr, nc))) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void build_component(int start) {
+    prob_component comp;
+    int slot;
+    if (free_slots.size() != 0) {
+      slot = free_slots[free_slots.size() - 1];
+      free_slots.removeLast();
+      @comps[slot] = @comp;
+    } else {
+      slot = comps.size();
+      comps.insertLast(@comp);
+    }
+
+    comp_of[start] = slot;
+    comp.cells.insertLast(start);
+    for (uint i = 0; i < comp.cells.size(); i++) {
+      int r = comp.cells[i] / cols;
+      int c = comp.cells[i] % cols;
+      for (int j = 0; j < 8; j++) {
+        int nr = r + dr[j];
+        int nc = c + dc[j];
+        if (!grid.in_bounds(nr, nc)) {
+          continue;
+        }
+        int con = grid.index(nr, nc);
+        if (!grid.revealed(con) || seen.get(con)) {
+          continue;
+        }
+        seen.set(con, true);
+        seen_list.insertLast(con);
+        comp.cons.insertLast(con);
+        for (int k = 0; k < 8; k++) {
+          int ur = nr + dr[k];
+          int uc = nc + dc[k];
+          if (!grid.in_bounds(ur, uc)) {
+            continue;
+          }
+          int u = grid.index(ur, uc);
+          if (unknown(u) && comp_of[u] == -1) {
+            comp_of[u] = slot;
+            comp.cells.insertLast(u);
+          }
+        }
+      }
+    }
+    for (uint i = 0; i < seen_list.size(); i++) {
+      seen.set(seen_list[i], false);
+    }
+    seen_list.resize(0);
+
+    enumerate(@comp);
+  }
+
+  void enumerate(prob_component@ comp) {
+    int k = comp.cells.size();
+    comp.valid = false;
+    comp.enumerated = k <= PROB_ENUM_LIMIT;
+    if (!comp.enumerated) {
+      return;
+    }
+
+    cell_cons.resize(k);
+    for (int j = 0; j < k; j++) {
+      cell_cons[j].resize(0);
+    }
+    con_rem.resize(comp.cons.size());
+    con_left.resize(comp.cons.size());
+    for (uint i = 0; i < comp.cons.size(); i++) {
+      int con = comp.cons[i];
+      int rem = grid.bomb_count(con);
+      int left = 0;
+      int r = con / cols;
+      int c = con % cols;
+      for (int d = 0; d < 8; d++) {
+        int nr = r + dr[d];
+        int nc = c + dc[d];
+        if (!grid.in_bounds(nr, nc)) {
+          continue;
+        }
+        int u = grid.index(nr, nc);
+        if (grid.marked(u)) {
+          rem--;
+        } else if (!grid.revealed(u)) {
+          left++;
+        }
+      }
+      con_rem[i] = rem;
+      con_left[i] = left;
+      for (int j = 0; j < k; j++) {
+        int cell = comp.cells[j];
+        if (abs(cell / cols - r) <= 1 && abs(cell % cols - c) <= 1) {
+          cell_cons[j].insertLast(i);
+        }
+      }
+    }
+
+    comp.sol.resize(0);
+    comp.sol.resize(k + 1);
+    comp.cell_mine.resize(0);
+    comp.cell_mine.resize(k * (k + 1));
+    for (int m = 0; m <= k; m++) {
+      comp.sol[m] = 0;
+    }
+    for (int i = 0; i < k * (k + 1); i++) {
+      comp.cell_mine[i] = 0;
+    }
+    assign.resize(k);
+    backtrack(@comp, 0, 0);
+
+    double total = 0;
+    for (int m = 0; m <= k; m++) {
+      total += comp.sol[m];
+    }
+    if (total == 0) {
+      /* Inconsistent, most likely a wrongly placed flag. */
+      return;
+    }
+    for (int m = 0; m <= k; m++) {
+      comp.sol[m] /= total;
+    }
+    for (int i = 0; i < k * (k + 1); i++) {
+      comp.cell_mine[i] /= total;
+    }
+    comp.prob.resize(k);
+    comp.valid = true;
+  }
+
+  void backtrack(prob_component@ comp, int j, int m) {
+    int k = comp.cells.size();
+    if (j == k) {
+      comp.sol[m] += 1;
+      for (int i = 0; i < k; i++) {
+        if (assign[i]) {
+          comp.cell_mine[i * (k + 1) + m] += 1;
+        }
+      }
+      return;
+    }
+
+    array<int>@ cons = @cell_cons[j];
+    for (int v = 0; v < 2; v++) {
+      bool ok = true;
+      for (uint i = 0; i < cons.size(); i++) {
+        int con = cons[i];
+        con_left[con]--;
+        con_rem[con] -= v;
+        if (con_rem[con] < 0 || con_rem[con] > con_left[con]) {
+          ok = false;
+        }
+      }
+      if (ok) {
+        assign[j] = v == 1;
+        backtrack(@comp, j + 1, m + v);
+      }
+      for (uint i = 0; i < cons.size(); i++) {
+        int con = cons[i];
+        con_left[con]++;
+        con_rem[con] += v;
+      }
+    }
+  }
+
+  void combine(int mines_left) {
+    /* Each component's mine count distribution is convolved with every other
+     * component's (via prefix and suffix products) and weighted by the number
+     * of ways to place the remaining mines on the U unknown cells off the
+     * frontier, C(U, mines_left - t).
+     */
+    array<prob_component@> valid;
+    int rest = 0;
+    for (int i = 0; i < rows * cols; i++) {
+      if (!unknown(i)) {
+        continue;
+      }
+      int slot = comp_of[i];
+      if (slot == -1 || !comps[slot].valid) {
+        rest++;
+      }
+    }
+    for (uint i = 0; i < comps.size(); i++) {
+      if (@comps[i] != null && comps[i].valid) {
+        valid.insertLast(@comps[i]);
+      }
+    }
+    int n = valid.size();
+
+    array<array<double> > prefix(n + 1);
+    array<array<double> > suffix(n + 1);
+    prefix[0].insertLast(1);
+    suffix[n].insertLast(1);
+    for (int i = 0; i < n; i++) {
+      convolve(@prefix[i], @valid[i].sol, @prefix[i + 1]);
+    }
+    for (int i = n - 1; i >= 0; i--) {
+      convolve(@suffix[i + 1], @valid[i].sol, @suffix[i]);
+    }
+
+    /* Relative C(rest, x) for x in [0, mines_left], normalized in log space
+     * to avoid overflow on large boards. */
+    array<double> ways(max(0, mines_left) + 1);
+    array<double> log_ways(ways.size());
+    double log_c = 0;
+    double best = -1e300;
+    for (int x = 0; x < int(ways.size()); x++) {
+      log_ways[x] = x <= rest ? log_c : -1e300;
+      if (log_ways[x] > best) {
+        best = log_ways[x];
+      }
+      if (x < rest) {
+        log_c += log(double(rest - x) / (x + 1));
+      }
+    }
+    for (uint x = 0; x < ways.size(); x++) {
+      ways[x] = log_ways[x] <= -1e299 ? 0 : exp(log_ways[x] - best);
+    }
+
+    double total = 0;
+    double rest_mines = 0;
+    array<double>@ all = @prefix[n];
+    for (int t = 0; t < int(all.size()) && t <= mines_left; t++) {
+      double w = all[t] * ways[mines_left - t];
+      total += w;
+      rest_mines += w * (mines_left - t);
+    }
+    rest_prob = total > 0 && rest > 0 ? float(rest_mines / total / rest) : 0;
+
+    array<double> others;
+    for (int i = 0; i < n; i++) {
+      prob_component@ comp = @valid[i];
+      convolve(@prefix[i], @suffix[i + 1], @others);
+      int k = comp.cells.size();
+
+      array<double> f(k + 1);
+      double norm = 0;
+      for (int m = 0; m <= k; m++) {
+        f[m] = 0;
+        for (int t = 0; t < int(others.size()) && m + t <= mines_left; t++) {
+          f[m] += others[t] * ways[mines_left - m - t];
+        }
+        norm += comp.sol[m] * f[m];
+      }
+      for (int j = 0; j < k; j++) {
+        double p = 0;
+        for (int m = 0; m <= k; m++) {
+          p += comp.cell_mine[j * (k + 1) + m] * f[m];
+        }
+        comp.prob[j] = norm > 0 ? float(p / norm) : -1;
+      }
+    }
+  }
+
+  void convolve(array<double>@ a, array<double>@ b, array<double>@ out) {
+    out.resize(0);
+    out.resize(a.size() + b.size() - 1);
+    for (uint i = 0; i < out.size(); i++) {
+      out[i] = 0;
+    }
+    for (uint i = 0; i < a.size(); i++) {
+      for (uint j = 0; j < b.size(); j++) {
+        out[i + j] += a[i] * b[j];
+      }
+    }
+  }
+}
@@ -0,0 +1,110 @@
+#include "../utils/bitset.cpp"
+
+/* Background style of a cell. */
+const int CELL_BG_UNPRESSED = 0;
+const int CELL_BG_PRESSED = 1;
+const int CELL_BG_REVEALED = 2;
+const int NUM_CELL_BGS = 3;
+
+/* What is drawn on top of a cell's background. Revealed counts use
+ * CELL_OVERLAY_COUNT + count for count in [1, 8].
+ */
+const int CELL_OVERLAY_NONE = 0;
+const int CELL_OVERLAY_FLAG = 1;
+const int CELL_OVERLAY_BOMB = 2;
+const int CELL_OVERLAY_KILLED = 3;
+const int CELL_OVERLAY_COUNT = 3;
+const int NUM_CELL_OVERLAYS = 12;
+
+class cell_buckets {
+  /* Partitions cell indices into buckets with O(1) moves. A cell in no bucket
+   * has bucket -1.
+   */
+  array<array<int> > members;
+  array<int> bucket_of;
+  array<int> slot_of;
+
+  void resize(int cells, int buckets) {
+    members.resize(0);
+    members.resize(buckets);
+    bucket_of.resize(cells);
+    slot_of.resize(cells);
+    for (int i = 0; i < cells; i++) {
+      bucket_of[i] = -1;
+    }
+  }
+
+  int bucket(int ind) const {
+    return bucket_of[ind];
+  }
+
+  void move(int ind, int b) {
+    int ob = bucket_of[ind];
+    if (ob == b) {
+      return;
+    }
+    if (ob != -1) {
+      array<int>@ m = @members[ob];
+      int slot = slot_of[ind];
+      int last = m[m.size() - 1];
+      m[slot] = last;
+      slot_of[last] = slot;
+      m.removeLast();
+    }
+    if (b != -1) {
+      slot_of[ind] = members[b].size();
+      members[b].insertLast(ind);
+    }
+    bucket_of[ind] = b;
+  }
+}
+
+class render_cache {
+  /* Retains the drawn style of every cell grouped by background and overlay
+   * so that draw() can emit each group with shared canvas state. Only cells
+   * that were invalidated since the last refresh have their style recomputed.
+   */
+  cell_buckets bgs;
+  cell_buckets overlays;
+
+  bitset dirty;
+  array<int> dirty_list;
+  bool all_dirty;
+
+  void resize(int cells) {
+    bgs.resize(cells, NUM_CELL_BGS);
+    overlays.resize(cells, NUM_CELL_OVERLAYS);
+    dirty.resize(cells);
+    dirty_list.resize(0);
+    all_dirty = true;
+  }
+
+  bool clean() const {
+    return !all_dirty && dirty_list.size() == 0;
+  }
+
+  void invalidate(int ind) {
+    if (!all_dirty && !dirty.get(ind)) {
+      dirty.set(ind, true);
+      dirty_list.insertLast(ind);
+    }
+  }
+
+  void invalidate_all() {
+    all_dirty = true;
+  }
+
+  void update(int ind, int bg, int overlay) {
+    bgs.move(ind, bg);
+    overlays.move(ind, overlay == CELL_OVERLAY_NONE ? -1 : overlay);
+  }
+
+  /* Resets the dirty state once every invalidated cell has been updated. */
+  void mark_clean() {
+    for (uint i = 0; i < dirty_list.size(); i++) {
+      dirty.set(dirty_list[i], false);
+    }
+    dirty_list.resize(0);
+    all_dirty = false;
+  }
+}
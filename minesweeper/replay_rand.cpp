@@ -1,113 +1,87 @@
-const uint NUM_ENCODERS = 4;
+#include "../utils/replay_encoder.cpp"
+
+/* Called once the seed has been passed to srand. */
+funcdef void seed_callback(uint seed);
 
 /* Usage:
  *
  * Instantiate a single instance of replay_rand in your script. Call step() on
- * the replay_rand object every time script.step is called. 
+ * the replay_rand object every time script.step is called. To share encoder
+ * entities with other replay_encoder consumers pass the shared encoder to the
+ * constructor and step the encoder instead.
  *
- * After frame 21 srand will have been called with a seed that will be
- * reproduced in a replay. Ensure that you do not rely on randomness before
- * frame 20 (this is normally before the player even has control).
+ * Once seed_set() returns true srand will have been called with a seed that
+ * will be reproduced in a replay. Outside of replays this happens on frame 1;
+ * in replays it happens as soon as the first desync frame after that restores
+ * the encoder positions, normally within a few frames. Pass a seed_callback
+ * to on_seed() to be notified right when that happens. The seed is checksummed
+ * and retried by replay_encoder so a corrupted decode never reaches srand;
+ * failed() is set if no valid seed was recovered by ENCODER_TIMEOUT.
  *
  * This can potentially fail if there is no player entity or if the player
- * entity moves significantly in the first 20 frames (dustman free fall should
- * be fine but entering a zip would probably break things).
+ * entity moves significantly before the seed is decoded (dustman free fall
+ * should be fine but entering a zip would probably break things).
  */
-class replay_rand {
-  scene@ g;
-	array<uint> encoders;
+class replay_rand : replay_consumer {
+  replay_encoder@ encoder;
+  bool owns_encoder;
   uint seed;
 
-  int ecx;
-  int ecy;
-  uint frame_counter;
+  bool decoded;
+  bool gave_up;
+  seed_callback@ callback;
 
-  replay_rand() {
-    @g = @get_scene();
+  replay_rand(replay_encoder@ shared = null) {
+    owns_encoder = @shared == null;
+    @encoder = owns_encoder ? @replay_encoder() : @shared;
+    decoded = false;
+    gave_up = false;
+    encoder.add(@this, 32);
   }
 
   void step() {
-    if (encoders.size() == 0) {
-      // Add some "encoder" entities at determinisitc positions relative
-      // to the plyaer entity.
-      init_encoders();
-      return;
-    }
-    if (frame_counter == 10) {
-      /* For non-replays generate a target seed and move the entities
-       * to encode that seed. */
-      encode_seed();
-    }
-    if (frame_counter == 20) {
-      /* Decode frames happen every 8 frames if there is significant movement
-       * near the player. Therefore 10 frames later should be more than nough
-       * to recover the encoded seed.
-       */
-      decode_seed();
+    if (owns_encoder) {
+      encoder.step();
     }
-    ++frame_counter;
   }
 
   bool seed_set() {
-    return frame_counter >= 20;
+    return decoded;
   }
 
-  void init_encoders() {
-    controllable@ ec = @controller_controllable(0);
-    if (@ec == null) {
-      return;
-    }
-
-    ecx = int(ec.x());
-    ecy = int(ec.y());
-    for (uint i = 0; i < NUM_ENCODERS; i++) {
-      scriptenemy@ ent = create_scriptenemy(replay_rand_dummy());
-      ent.x(ecx);
-      ent.y(ecy);
-      g.add_entity(@ent.as_entity());
-      encoders.insertLast(ent.id());
-    }
+  bool failed() {
+    return gave_up;
   }
 
-  void encode_seed() {
-    if (is_replay()) {
-      return;
+  /* Registers a callback run once the seed is set, or immediately if it
+   * already is. */
+  void on_seed(seed_callback@ cb) {
+    @callback = @cb;
+    if (decoded) {
+      callback(seed);
     }
+  }
 
+  uint encode_value() {
+    /* For non-replays generate a target seed. */
     srand(timestamp_now() + get_time_us());
     seed = rand();
     puts("seed is " + seed);
-    for (uint i = 0; i < NUM_ENCODERS; i++) {
-      entity@ ent = @entity_by_id(encoders[i]);
-      if (@ent == null) {
-        puts("encoding seed failed");
-        return;
-      }
-      ent.x(ecx - 128 + ((seed >> (i * 8)) & 0xFF));
-      ent.y(ecy + 100);
-    }
+    return seed;
   }
 
-  void decode_seed() {
-    seed = 0;
-    for (uint i = 0; i < NUM_ENCODERS; i++) {
-      entity@ ent = @entity_by_id(encoders[i]);
-      if (@ent == null) {
-        puts("seed reconstruction failed");
-        return;
-      }
-      int enc_x = int(round(ent.x())) + 128 - ecx;
-      int enc_y = int(round(ent.y()));
-      if (enc_y == ecy) {
-        puts("desync frames missing, seed reconstruction failed");
-        return;
-      }
-      seed |= enc_x << (i * 8);
-    }
+  void on_decoded(uint value) {
+    seed = value;
+    decoded = true;
     puts("constructed seed " + seed);
     srand(seed);
+    if (@callback != null) {
+      callback(seed);
+    }
   }
-}
 
-class replay_rand_dummy : enemy_base {
+  void on_failed() {
+    puts("seed reconstruction failed");
+    gave_up = true;
+  }
 }
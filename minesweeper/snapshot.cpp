@@ -0,0 +1,250 @@
+#include "board.cpp"
+
+/* Flags describing the game state stored alongside the board. */
+const int BOARD_FLAG_READY = 0x1; /* Mines have been placed */
+const int BOARD_FLAG_DEAD = 0x2;
+const int BOARD_FLAG_FINISHED = 0x4;
+
+/* Snapshot layout: a header followed by the words of the bomb, revealed,
+ * marked and killed bitsets in that order.
+ */
+const uint SNAPSHOT_VERSION = 1;
+const int SNAPSHOT_HEADER = 6;
+
+class board_snapshot {
+  /* Bit-packed copy of the board state held in a plain array<uint> so it can
+   * live in a [hidden] persisted field. take() writes the whole board while
+   * update() only rewrites the words holding the given cells.
+   */
+  array<uint>@ words;
+
+  board_snapshot(array<uint>@ words) {
+    @this.words = @words;
+  }
+
+  bool empty() const {
+    return words.size() == 0;
+  }
+
+  void take(board@ grid, int marks, int reveal_count, int flags) {
+    uint w = grid.bomb_bits.words.size();
+    words.resize(SNAPSHOT_HEADER + 4 * w);
+    words[0] = SNAPSHOT_VERSION;
+    words[1] = grid.rows;
+    words[2] = grid.cols;
+    counters(marks, reveal_count, flags);
+    for (uint i = 0; i < w; i++) {
+      words[SNAPSHOT_HEADER + i] = grid.bomb_bits.words[i];
+      words[SNAPSHOT_HEADER + w + i] = grid.revealed_bits.words[i];
+      words[SNAPSHOT_HEADER + 2 * w + i] = grid.marked_bits.words[i];
+      words[SNAPSHOT_HEADER + 3 * w + i] = grid.killed_bits.words[i];
+    }
+  }
+
+  int flags() const {
+    return empty() ? 0 : int(words[5]);
+  }
+
+  void counters(int marks, int reveal_count, int flags) {
+    words[3] = uint(marks);
+    words[4] = uint(reveal_count);
+    words[5] = uint(flags);
+  }
+
+  /* Refreshes the snapshot words that hold each cell in cells. Mines never
+   * change once placed so only player state is copied. */
+  void update(board@ grid, array<int>@ cells) {
+    uint w = grid.bomb_bits.words.size();
+    for (uint i = 0; i < cells.size(); i++) {
+      uint ind = cells[i] >> 5;
+      words[SNAPSHOT_HEADER + w + ind] = grid.revealed_bits.words[ind];
+      words[SNAPSHOT_HEADER + 2 * w + ind] = grid.marked_bits.words[ind];
+      words[SNAPSHOT_HEADER + 3 * w + ind] = grid.killed_bits.words[ind];
+    }
+  }
+
+  /* Loads the snapshot into grid, which must already have the snapshot's
+   * dimensions. Returns false if the snapshot doesn't match. */
+  bool restore(board@ grid, int &out marks, int &out reveal_count, int &out flags) {
+    uint w = grid.bomb_bits.words.size();
+    if (words.size() != SNAPSHOT_HEADER + 4 * w || words[0] != SNAPSHOT_VERSION ||
+        int(words[1]) != grid.rows || int(words[2]) != grid.cols) {
+      return false;
+    }
+    marks = int(words[3]);
+    reveal_count = int(words[4]);
+    flags = int(words[5]);
+
+    grid.clear();
+    for (uint i = 0; i < w; i++) {
+      grid.revealed_bits.words[i] = words[SNAPSHOT_HEADER + w + i];
+      grid.marked_bits.words[i] = words[SNAPSHOT_HEADER + 2 * w + i];
+      grid.killed_bits.words[i] = words[SNAPSHOT_HEADER + 3 * w + i];
+
+      /* Counts are rebuilt from the mines. */
+      uint bits = words[SNAPSHOT_HEADER + i];
+      for (int b = 0; b < 32; b++) {
+        if ((bits & (uint(1) << b)) != 0) {
+          grid.add_bomb(int(i) * 32 + b);
+        }
+      }
+    }
+    return true;
+  }
+}
+
+/* Delta log entry types, stored in the low two bits of each entry. */
+const uint LOG_REVEAL = 0;
+const uint LOG_MARK = 1;
+const uint LOG_BOMB = 2;
+
+/* Per step record: entry offset, then flags/marks/reveal_count before and
+ * after the step. */
+const int LOG_STEP_STRIDE = 7;
+
+/* Steps kept in the log; recording past this forgets the oldest step. */
+const int BOARD_LOG_MAX_STEPS = 256;
+
+class board_log {
+  /* Records the cells each step changes so steps can be undone and redone
+   * in O(changed cells). Steps in [0, cursor) are applied; recording a new
+   * step discards any undone steps after the cursor. At most
+   * BOARD_LOG_MAX_STEPS steps are kept, so the oldest can't be undone.
+   */
+  array<uint> entries;
+  array<int> steps;
+  int cursor;
+
+  bool open;
+  int open_flags;
+  int open_marks;
+  int open_reveal_count;
+
+  board_log() {
+    cursor = 0;
+    open = false;
+  }
+
+  int num_steps() const {
+    return steps.size() / LOG_STEP_STRIDE;
+  }
+
+  /* Called at the start of each step with the current counters. */
+  void begin(int flags, int marks, int reveal_count) {
+    open = false;
+    open_flags = flags;
+    open_marks = marks;
+    open_reveal_count = reveal_count;
+  }
+
+  void record(int ind, uint type) {
+    if (!open) {
+      int end = cursor == num_steps() ? entries.size() :
+          steps[cursor * LOG_STEP_STRIDE];
+      entries.resize(end);
+      steps.resize(cursor * LOG_STEP_STRIDE);
+      if (num_steps() == BOARD_LOG_MAX_STEPS) {
+        drop_oldest();
+        end = entries.size();
+      }
+      steps.insertLast(end);
+      steps.insertLast(open_flags);
+      steps.insertLast(open_marks);
+      steps.insertLast(open_reveal_count);
+      steps.insertLast(0);
+      steps.insertLast(0);
+      steps.insertLast(0);
+      cursor++;
+      open = true;
+    }
+    entries.insertLast((uint(ind) << 2) | type);
+  }
+
+  void drop_oldest() {
+    uint cut = uint(entry_end(0));
+    for (uint i = cut; i < entries.size(); i++) {
+      entries[i - cut] = entries[i];
+    }
+    entries.resize(entries.size() - cut);
+    for (uint i = LOG_STEP_STRIDE; i < steps.size(); i++) {
+      steps[i - LOG_STEP_STRIDE] = steps[i];
+    }
+    steps.resize(steps.size() - LOG_STEP_STRIDE);
+    for (int i = 0; i < num_steps(); i++) {
+      steps[i * LOG_STEP_STRIDE] -= int(cut);
+    }
+    cursor--;
+  }
+
+  /* Called once the step's changes are done with the resulting counters. */
+  void end(int flags, int marks, int reveal_count) {
+    if (!open) {
+      return;
+    }
+    int base = (cursor - 1) * LOG_STEP_STRIDE;
+    steps[base + 4] = flags;
+    steps[base + 5] = marks;
+    steps[base + 6] = reveal_count;
+    open = false;
+  }
+
+  int entry_end(int step) const {
+    return step + 1 == num_steps() ? entries.size() :
+        steps[(step + 1) * LOG_STEP_STRIDE];
+  }
+
+  /* Counters of the board at the cursor, offset 0 for flags, 1 for marks
+   * and 2 for reveal_count. */
+  int counter(int which) const {
+    if (cursor == 0) {
+      return num_steps() == 0 ? 0 : steps[1 + which];
+    }
+    return steps[(cursor - 1) * LOG_STEP_STRIDE + 4 + which];
+  }
+
+  /* Reverts the last applied step, appending the cells it touched. */
+  bool undo(board@ grid, array<int>@ touched) {
+    if (cursor == 0) {
+      return false;
+    }
+    cursor--;
+    int start = steps[cursor * LOG_STEP_STRIDE];
+    for (int i = entry_end(cursor) - 1; i >= start; i--) {
+      int ind = int(entries[i] >> 2);
+      uint type = entries[i] & 3;
+      if (type == LOG_REVEAL) {
+        grid.revealed(ind, false);
+        grid.killed(ind, false);
+      } else if (type == LOG_MARK) {
+        grid.marked(ind, !grid.marked(ind));
+      } else {
+        grid.remove_bomb(ind);
+      }
+      touched.insertLast(ind);
+    }
+    return true;
+  }
+
+  /* Reapplies the next undone step, appending the cells it touched. */
+  bool redo(board@ grid, array<int>@ touched) {
+    if (cursor == num_steps()) {
+      return false;
+    }
+    int end = entry_end(cursor);
+    for (int i = steps[cursor * LOG_STEP_STRIDE]; i < end; i++) {
+      int ind = int(entries[i] >> 2);
+      uint type = entries[i] & 3;
+      if (type == LOG_REVEAL) {
+        grid.revealed(ind, true);
+        grid.killed(ind, grid.bomb(ind));
+      } else if (type == LOG_MARK) {
+        grid.marked(ind, !grid.marked(ind));
+      } else {
+        grid.add_bomb(ind);
+      }
+      touched.insertLast(ind);
+    }
+    cursor++;
+    return true;
+  }
+}
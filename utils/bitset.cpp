@@ -0,0 +1,87 @@
+/* Usage:
+ *
+ * bitset and nibble_array are flat packed arrays of 1-bit and 4-bit values.
+ * Call resize(n) to allocate (and zero) storage for n entries and then use
+ * get/set to access individual entries by index.
+ */
+class bitset {
+  array<uint> words;
+  int count;
+
+  bitset() {
+    count = 0;
+  }
+
+  void resize(int n) {
+    count = n;
+    words.resize((n + 31) >> 5);
+    clear();
+  }
+
+  void clear() {
+    for (uint i = 0; i < words.size(); i++) {
+      words[i] = 0;
+    }
+  }
+
+  int size() const {
+    return count;
+  }
+
+  bool get(int i) const {
+    return ((words[i >> 5] >> (i & 31)) & 1) != 0;
+  }
+
+  void set(int i, bool val) {
+    if (val) {
+      words[i >> 5] |= uint(1) << (i & 31);
+    } else {
+      words[i >> 5] &= ~(uint(1) << (i & 31));
+    }
+  }
+
+  void flip(int i) {
+    words[i >> 5] ^= uint(1) << (i & 31);
+  }
+}
+
+class nibble_array {
+  array<uint> words;
+  int count;
+
+  nibble_array() {
+    count = 0;
+  }
+
+  void resize(int n) {
+    count = n;
+    words.resize((n + 7) >> 3);
+    clear();
+  }
+
+  void clear() {
+    for (uint i = 0; i < words.size(); i++) {
+      words[i] = 0;
+    }
+  }
+
+  int size() const {
+    return count;
+  }
+
+  int get(int i) const {
+    return (words[i >> 3] >> ((i & 7) << 2)) & 0xF;
+  }
+
+  void set(int i, int val) {
+    uint sh = (i & 7) << 2;
+    words[i >> 3] = (words[i >> 3] & ~(uint(0xF) << sh)) |
+                    ((uint(val) & 0xF) << sh);
+  }
+
+  /* Adds val to entry i. The caller must ensure the result stays within
+   * [0, 15] as carries would spill into the neighbouring entry. */
+  void add(int i, int val) {
+    words[i >> 3] += uint(val) << ((i & 7) << 2);
+  }
+}
@@ -0,0 +1,54 @@
+/* Usage:
+ *
+ * controller_cache remembers the entity each player controls so asking which
+ * player, if any, controls an entity doesn't call into the engine once per
+ * camera. Change controlled entities through set(), which forwards to
+ * controller_entity() and updates the cache.
+ *
+ * The engine also assigns entities itself, e.g. to spawned players and on
+ * checkpoint loads, so the cache checks itself rather than waiting to be
+ * told. A cached match is confirmed with a single controller_controllable()
+ * call, and a lookup the cache can't confirm asks the engine for every
+ * player again before returning -1. Lookups give the same answer as asking
+ * the engine directly; only entities no player controls pay for the full
+ * check.
+ */
+class controller_cache {
+  array<controllable@> entities; /* Controlled entity per player or null */
+
+  void refresh() {
+    entities.resize(num_cameras());
+    for (uint i = 0; i < entities.size(); i++) {
+      @entities[i] = @controller_controllable(i);
+    }
+  }
+
+  int find(entity@ e) const {
+    for (uint i = 0; i < entities.size(); i++) {
+      if (@entities[i] != null && entities[i].is_same(@e)) {
+        return int(i);
+      }
+    }
+    return -1;
+  }
+
+  /* Returns the player controlling e or -1. */
+  int player_of(entity@ e) {
+    int i = find(@e);
+    if (i != -1) {
+      controllable@ c = @controller_controllable(i);
+      if (@c != null && c.is_same(@e)) {
+        return i;
+      }
+    }
+    refresh();
+    return find(@e);
+  }
+
+  void set(int player, controllable@ c) {
+    controller_entity(player, @c);
+    if (0 <= player && player < int(entities.size())) {
+      @entities[player] = @c;
+    }
+  }
+}
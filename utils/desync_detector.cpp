@@ -0,0 +1,110 @@
+#include "replay_telemetry.cpp"
+#include "desync_hash.cpp"
+
+/* Frames covered by each hashed interval. */
+const uint DESYNC_INTERVAL = 60;
+
+/* Each committed value holds the low 8 bits of the interval index above the
+ * low 24 bits of that interval's hash. Local hashes are kept for the last
+ * DESYNC_HISTORY intervals so replays can compare them once the recorded
+ * value arrives, which lags by up to a few packets.
+ */
+const uint DESYNC_HASH_MASK = 0xFFFFFF;
+const uint DESYNC_HISTORY = 256;
+
+/* Usage:
+ *
+ * Instantiate a desync_detector in your script, point desync_hash at it, and
+ * call step() every time script.step is called. The detector spawns encoder
+ * entities and streams through them every frame, so scripts should only
+ * create one when asked to (e.g. through a [check] option). Anything that should play
+ * back identically in a replay is fed with add() while it runs, e.g. from
+ * entity step() methods:
+ *
+ *   if (@desync_hash != null) {
+ *     desync_hash.add(x);
+ *   }
+ *
+ * Feeding costs a multiply and a few bit operations per value. Every
+ * DESYNC_INTERVAL frames the interval's hash is pushed through a
+ * replay_telemetry channel. During replays the recomputed hashes are compared
+ * against the recorded ones and the first interval that differs is reported
+ * in first_divergence (-1 while none has) and with puts.
+ *
+ * The channel can miss packets in a replay, so values are matched to local
+ * intervals by their tagged index rather than by arrival order. Intervals
+ * whose value never arrived are counted in missed and left unchecked; a
+ * value for an interval already checked is ignored.
+ *
+ * Floats are hashed at 1/256 px precision so differences far below anything
+ * visible don't trigger a report.
+ */
+class desync_detector : desync_sink {
+  replay_telemetry channel;
+  uint hash;
+  uint frame;
+  uint interval;
+  array<uint> history;
+
+  int first_divergence;
+  uint checked; /* Intervals compared against the replay */
+  uint missed; /* Intervals whose recorded value was lost */
+  int last_checked; /* Index of the last interval compared, or -1 */
+
+  desync_detector() {
+    hash = 2166136261;
+    frame = 0;
+    interval = 0;
+    history.resize(DESYNC_HISTORY);
+    first_divergence = -1;
+    checked = 0;
+    missed = 0;
+    last_checked = -1;
+  }
+
+  void add(int value) {
+    hash = (hash ^ uint(value)) * 16777619;
+    hash ^= hash >> 15;
+  }
+
+  void add(float value) {
+    add(int(floor(value * 256)));
+  }
+
+  void step() {
+    channel.step();
+    ++frame;
+    if (frame % DESYNC_INTERVAL == 0) {
+      history[interval % DESYNC_HISTORY] = hash & DESYNC_HASH_MASK;
+      channel.push(((interval & 0xFF) << 24) | (hash & DESYNC_HASH_MASK));
+      interval++;
+      hash = 2166136261;
+    }
+
+    uint value;
+    while (channel.pop(value)) {
+      check(value);
+    }
+  }
+
+  void check(uint value) {
+    /* Recover the full interval index from its low bits; recorded values
+     * are never ahead of the local interval count. */
+    if (interval == 0) {
+      return;
+    }
+    uint idx = interval - 1 - ((interval - 1 - (value >> 24)) & 0xFF);
+    if (interval - idx > DESYNC_HISTORY || int(idx) <= last_checked) {
+      return;
+    }
+    missed += idx - uint(last_checked + 1);
+    last_checked = int(idx);
+    checked++;
+    if (first_divergence == -1 &&
+        history[idx % DESYNC_HISTORY] != (value & DESYNC_HASH_MASK)) {
+      first_divergence = int(idx);
+      puts("replay desync in frames " + idx * DESYNC_INTERVAL + "-" +
+           ((idx + 1) * DESYNC_INTERVAL - 1));
+    }
+  }
+}
@@ -0,0 +1,11 @@
+/* Receiver of the values entities feed into a replay desync check, see
+ * desync_detector.cpp. Entities only need this file, so they can be included
+ * by scripts that don't run a detector. */
+interface desync_sink {
+  void add(int value);
+  void add(float value);
+}
+
+/* Sink scripts share with the entities feeding it, or null if the running
+ * script doesn't check for desyncs. */
+desync_sink@ desync_hash = null;
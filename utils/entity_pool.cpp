@@ -0,0 +1,131 @@
+/* Where released entities are parked, far outside any map. */
+const float ENTITY_POOL_PARK_X = -1000000;
+const float ENTITY_POOL_PARK_Y = -1000000;
+
+funcdef entity@ entity_factory();
+funcdef void entity_hook(entity@ e);
+
+/* Usage:
+ *
+ * Create an entity_pool with a factory that returns a new, not yet added,
+ * entity of the kind to pool, and optionally hooks run on every entity as it
+ * is handed out and taken back (e.g. to reset its vars). acquire() returns a
+ * parked entity, creating one only when none are free. Set it up (layer,
+ * position, vars) and then call place() on it: a newly created entity is
+ * added to the scene only then, so it is configured before the engine first
+ * sees it, and a reused one is already in the scene. release() parks it again
+ * instead of removing it from the scene. All of these are O(1).
+ *
+ * Pooled entities stay in the scene parked at
+ * (ENTITY_POOL_PARK_X, ENTITY_POOL_PARK_Y) while unused. Loading a checkpoint
+ * destroys them along with the rest of the scene, and their ids can then be
+ * handed to other entities. acquire() checks each free id before reusing it
+ * and drops any that no longer names an entity sitting at the park position,
+ * so the pool needs no help from the script across checkpoints; clear()
+ * just forgets everything at once. prefill(n) creates and adds n entities up front, for kinds
+ * that need no setup before being added. high_water is the most entities
+ * ever in use at once; stats() prints it along with the current counts to
+ * help size prefill per map.
+ */
+class entity_pool {
+  entity_factory@ factory;
+  entity_hook@ on_acquire;
+  entity_hook@ on_release;
+
+  array<entity@> free;
+  array<int> free_ids; /* Scene id of each free entity */
+  entity@ pending; /* Created by acquire() and not yet placed */
+  uint created;
+  uint in_use;
+  uint high_water;
+
+  entity_pool(entity_factory@ factory, entity_hook@ on_acquire = null,
+              entity_hook@ on_release = null) {
+    @this.factory = @factory;
+    @this.on_acquire = @on_acquire;
+    @this.on_release = @on_release;
+    created = 0;
+    in_use = 0;
+    high_water = 0;
+  }
+
+  void prefill(uint n) {
+    while (created < n) {
+      entity@ e = @create();
+      add(@e);
+      free.insertLast(@e);
+      free_ids.insertLast(e.id());
+    }
+  }
+
+  /* Forgets every pooled entity, e.g. after a checkpoint load removed them. */
+  void clear() {
+    free.resize(0);
+    free_ids.resize(0);
+    @pending = null;
+    created = 0;
+    in_use = 0;
+  }
+
+  entity@ acquire() {
+    entity@ e = null;
+    while (@e == null && free.size() != 0) {
+      int id = free_ids[free_ids.size() - 1];
+      free.removeLast();
+      free_ids.removeLast();
+      @e = @entity_by_id(id);
+      if (@e != null && (e.x() != ENTITY_POOL_PARK_X ||
+                         e.y() != ENTITY_POOL_PARK_Y)) {
+        /* The id now belongs to some other entity. */
+        @e = null;
+      }
+      if (@e == null) {
+        created--;
+      }
+    }
+    if (@e == null) {
+      @e = @create();
+      @pending = @e;
+    }
+    in_use++;
+    high_water = max(high_water, in_use);
+    if (@on_acquire != null) {
+      on_acquire(@e);
+    }
+    return e;
+  }
+
+  /* Adds e to the scene if acquire() just created it. */
+  void place(entity@ e) {
+    if (e is pending) {
+      add(@e);
+      @pending = null;
+    }
+  }
+
+  void release(entity@ e) {
+    if (@on_release != null) {
+      on_release(@e);
+    }
+    e.set_xy(ENTITY_POOL_PARK_X, ENTITY_POOL_PARK_Y);
+    free.insertLast(@e);
+    free_ids.insertLast(e.id());
+    in_use--;
+  }
+
+  string stats() const {
+    return "" + in_use + " in use, " + free.size() + " free, " + created +
+           " created, high water " + high_water;
+  }
+
+  entity@ create() {
+    entity@ e = @factory();
+    e.set_xy(ENTITY_POOL_PARK_X, ENTITY_POOL_PARK_Y);
+    created++;
+    return e;
+  }
+
+  void add(entity@ e) {
+    get_scene().add_entity(@e, false);
+  }
+}
@@ -0,0 +1,238 @@
+/* Packs a coordinate pair into one int key. Each coordinate keeps its low 16
+ * bits, so pairs are distinct for coordinates in [-32768, 32767].
+ */
+int pack_xy(int x, int y) {
+  return (x & 0xFFFF) | (y << 16);
+}
+
+int unpack_x(int key) {
+  return (key << 16) >>> 16;
+}
+
+int unpack_y(int key) {
+  return key >>> 16;
+}
+
+/* Murmur3 finalizer; spreads nearby keys across the table. */
+uint hash_int(int key) {
+  uint h = uint(key);
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+/* Usage:
+ *
+ * int_map maps int keys (ids, or coordinates packed with pack_xy) to int
+ * values; int_set holds int keys. Both are open addressing tables with linear
+ * probing in flat arrays. Deleting shifts the following entries of the probe
+ * run back instead of leaving tombstones, so lookups never slow down as
+ * entries come and go. clear() keeps the storage and reserve(n) sizes it up
+ * front so n entries fit without reallocating.
+ *
+ * To iterate, loop i over [0, capacity()) and read key_at(i) (and value_at(i))
+ * for every slot where used(i). The order depends on the hashes, not on
+ * insertion order, and changes when entries are added or removed.
+ *
+ * To map to something other than an int store it in an array and map to its
+ * index.
+ */
+class int_map {
+  array<int> keys;
+  array<int> values;
+  array<bool> full;
+  uint mask;
+  uint count;
+
+  int_map() {
+    count = 0;
+    alloc(16);
+  }
+
+  uint size() const {
+    return count;
+  }
+
+  uint capacity() const {
+    return keys.size();
+  }
+
+  bool used(uint i) const {
+    return full[i];
+  }
+
+  int key_at(uint i) const {
+    return keys[i];
+  }
+
+  int value_at(uint i) const {
+    return values[i];
+  }
+
+  void clear() {
+    for (uint i = 0; i < full.size(); i++) {
+      full[i] = false;
+    }
+    count = 0;
+  }
+
+  /* Makes room for n entries without further growth. */
+  void reserve(uint n) {
+    uint cap = keys.size();
+    while (n * 4 > cap * 3) {
+      cap <<= 1;
+    }
+    if (cap != keys.size()) {
+      rehash(cap);
+    }
+  }
+
+  /* Returns the slot holding key or -1. */
+  int find(int key) const {
+    uint i = hash_int(key) & mask;
+    while (full[i]) {
+      if (keys[i] == key) {
+        return int(i);
+      }
+      i = (i + 1) & mask;
+    }
+    return -1;
+  }
+
+  bool has(int key) const {
+    return find(key) != -1;
+  }
+
+  bool get(int key, int &out value) const {
+    int i = find(key);
+    if (i == -1) {
+      return false;
+    }
+    value = values[i];
+    return true;
+  }
+
+  /* Returns the value for key or def if it isn't present. */
+  int get_or(int key, int def) const {
+    int i = find(key);
+    return i == -1 ? def : values[i];
+  }
+
+  void set(int key, int value) {
+    if ((count + 1) * 4 > keys.size() * 3) {
+      rehash(keys.size() << 1);
+    }
+    uint i = hash_int(key) & mask;
+    while (full[i]) {
+      if (keys[i] == key) {
+        values[i] = value;
+        return;
+      }
+      i = (i + 1) & mask;
+    }
+    full[i] = true;
+    keys[i] = key;
+    values[i] = value;
+    count++;
+  }
+
+  bool remove(int key) {
+    int i = find(key);
+    if (i == -1) {
+      return false;
+    }
+    remove_slot(uint(i));
+    return true;
+  }
+
+  void remove_slot(uint i) {
+    /* Backward shift: pull later entries of the run into the hole unless
+     * their home slot lies cyclically after the hole. */
+    uint j = i;
+    while (true) {
+      j = (j + 1) & mask;
+      if (!full[j]) {
+        break;
+      }
+      uint home = hash_int(keys[j]) & mask;
+      if (((j - home) & mask) >= ((j - i) & mask)) {
+        keys[i] = keys[j];
+        values[i] = values[j];
+        i = j;
+      }
+    }
+    full[i] = false;
+    count--;
+  }
+
+  void alloc(uint cap) {
+    keys.resize(cap);
+    values.resize(cap);
+    full.resize(cap);
+    for (uint i = 0; i < cap; i++) {
+      full[i] = false;
+    }
+    mask = cap - 1;
+  }
+
+  void rehash(uint cap) {
+    array<int> old_keys = keys;
+    array<int> old_values = values;
+    array<bool> old_full = full;
+    alloc(cap);
+    count = 0;
+    for (uint i = 0; i < old_full.size(); i++) {
+      if (old_full[i]) {
+        set(old_keys[i], old_values[i]);
+      }
+    }
+  }
+}
+
+class int_set {
+  int_map map;
+
+  uint size() const {
+    return map.size();
+  }
+
+  uint capacity() const {
+    return map.capacity();
+  }
+
+  bool used(uint i) const {
+    return map.used(i);
+  }
+
+  int key_at(uint i) const {
+    return map.key_at(i);
+  }
+
+  void clear() {
+    map.clear();
+  }
+
+  void reserve(uint n) {
+    map.reserve(n);
+  }
+
+  bool has(int key) const {
+    return map.find(key) != -1;
+  }
+
+  /* Returns true if key was newly added. */
+  bool insert(int key) {
+    if (map.has(key)) {
+      return false;
+    }
+    map.set(key, 0);
+    return true;
+  }
+
+  bool remove(int key) {
+    return map.remove(key);
+  }
+}
@@ -0,0 +1,59 @@
+#include "hash_map.cpp"
+
+/* Usage:
+ *
+ * Call hash_map_bench(n) from a script (e.g. once from script.step) to time
+ * n inserts, lookups and removals of packed tile coordinates in an int_map
+ * against the same operations on a plain array scanned linearly, the way
+ * blob::clean_tiles used to be searched. Results are printed with puts.
+ */
+void hash_map_bench(int n) {
+  array<int> keys(n);
+  for (int i = 0; i < n; i++) {
+    keys[i] = pack_xy(i * 7 % 251 - 125, i / 251);
+  }
+
+  int64 t0 = get_time_us();
+  int_map map;
+  map.reserve(n);
+  for (int i = 0; i < n; i++) {
+    map.set(keys[i], i);
+  }
+  int found = 0;
+  for (int i = 0; i < n; i++) {
+    if (map.has(keys[(i * 31) % n])) {
+      found++;
+    }
+  }
+  for (int i = 0; i < n; i++) {
+    map.remove(keys[i]);
+  }
+  int64 t1 = get_time_us();
+
+  array<int> list;
+  for (int i = 0; i < n; i++) {
+    list.insertLast(keys[i]);
+  }
+  for (int i = 0; i < n; i++) {
+    int key = keys[(i * 31) % n];
+    for (uint j = 0; j < list.size(); j++) {
+      if (list[j] == key) {
+        found++;
+        break;
+      }
+    }
+  }
+  for (int i = 0; i < n; i++) {
+    for (uint j = 0; j < list.size(); j++) {
+      if (list[j] == keys[i]) {
+        list[j] = list[list.size() - 1];
+        list.removeLast();
+        break;
+      }
+    }
+  }
+  int64 t2 = get_time_us();
+
+  puts("hash_map_bench n=" + n + ": int_map " + (t1 - t0) + "us, array scan " +
+       (t2 - t1) + "us (" + found + " found)");
+}
@@ -0,0 +1,89 @@
+interface job {
+  /* Does units of work, taking one from budget for each, until finished or
+   * until budget reaches zero. Returns true once the job is finished. */
+  bool run(int &inout budget);
+}
+
+/* Usage:
+ *
+ * Create a job_scheduler with a per frame budget in units of work and call
+ * step() once per frame, e.g. from script.step. submit() queues a resumable
+ * job with a priority; each step runs jobs highest priority first (oldest
+ * first among equals), handing each the units left, until the budget is
+ * spent or the queue is empty. Finished jobs are dropped from the queue.
+ *
+ * The budget counts work rather than time so the frame a job finishes on
+ * doesn't depend on the machine, and gameplay waiting on a job plays back
+ * the same in replays. Pick a unit small enough that a full budget fits in a
+ * frame; max_depth and worst_step_us record how deep the queue got and the
+ * longest a step took, and stats() prints them.
+ */
+class job_scheduler {
+  int budget;
+  array<job@> jobs;
+  array<int> priorities;
+
+  uint max_depth;
+  uint completed;
+  uint frames; /* Steps that ran at least one job */
+  int worst_step_us;
+
+  job_scheduler(int budget) {
+    this.budget = budget;
+    max_depth = 0;
+    completed = 0;
+    frames = 0;
+    worst_step_us = 0;
+  }
+
+  uint depth() const {
+    return jobs.size();
+  }
+
+  void submit(job@ j, int priority = 0) {
+    /* Keep the queue sorted by descending priority, FIFO among equals. */
+    uint pos = jobs.size();
+    while (pos > 0 && priorities[pos - 1] < priority) {
+      pos--;
+    }
+    jobs.insertAt(pos, @j);
+    priorities.insertAt(pos, priority);
+    max_depth = max(max_depth, jobs.size());
+  }
+
+  bool cancel(job@ j) {
+    for (uint i = 0; i < jobs.size(); i++) {
+      if (jobs[i] is j) {
+        jobs.removeAt(i);
+        priorities.removeAt(i);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void step() {
+    if (jobs.size() == 0) {
+      return;
+    }
+    frames++;
+    int64 start = get_time_us();
+    int left = budget;
+    while (jobs.size() != 0 && left > 0) {
+      if (!jobs[0].run(left)) {
+        /* The job had the rest of the budget. */
+        break;
+      }
+      jobs.removeAt(0);
+      priorities.removeAt(0);
+      completed++;
+    }
+    worst_step_us = max(worst_step_us, int(get_time_us() - start));
+  }
+
+  string stats() const {
+    return "" + jobs.size() + " queued (max " + max_depth + "), " + completed +
+           " completed over " + frames + " frames, worst step " +
+           worst_step_us + "us";
+  }
+}
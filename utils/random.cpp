@@ -0,0 +1,115 @@
+const uint64 PCG_MULT = 6364136223846793005;
+
+/* Hashes a stream name to a pcg32 stream id (64-bit FNV-1a). */
+uint64 pcg_stream(const string &in name) {
+  uint64 h = 14695981039346656037;
+  for (uint i = 0; i < name.length(); i++) {
+    h = (h ^ name[i]) * 1099511628211;
+  }
+  return h;
+}
+
+/* Usage:
+ *
+ * pcg32 is a small, fast PCG-XSH-RR generator that is independent of the
+ * engine's global rand() stream. Seed it with the replay seed (see
+ * replay_rand) and a stream, either a number or a name like
+ * "minesweeper.grid". Generators with the same seed but different streams
+ * produce independent sequences, so each subsystem can own its own stream
+ * and be unaffected by how much any other consumes.
+ *
+ * advance(n) skips n outputs in O(log n), which lets lazily generated content
+ * jump straight to its part of a stream. The fill methods write a whole array
+ * at once for hot loops.
+ */
+class pcg32 {
+  uint64 state;
+  uint64 inc;
+
+  pcg32() {
+    seed(0, 0);
+  }
+
+  pcg32(uint64 seed, uint64 stream) {
+    this.seed(seed, stream);
+  }
+
+  void seed(uint64 seed, uint64 stream) {
+    state = 0;
+    inc = (stream << 1) | 1;
+    next();
+    state += seed;
+    next();
+  }
+
+  void seed(uint64 seed, const string &in name) {
+    this.seed(seed, pcg_stream(name));
+  }
+
+  uint next() {
+    uint64 old = state;
+    state = old * PCG_MULT + inc;
+    uint xorshifted = uint(((old >> 18) ^ old) >> 27);
+    uint rot = uint(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+  }
+
+  /* Uniform value in [0, n) without modulo bias. n must be positive. */
+  uint below(uint n) {
+    uint threshold = (uint(0) - n) % n;
+    while (true) {
+      uint r = next();
+      if (r >= threshold) {
+        return r % n;
+      }
+    }
+    return 0;
+  }
+
+  /* Uniform value in [lo, hi). */
+  int range(int lo, int hi) {
+    return lo + int(below(uint(hi - lo)));
+  }
+
+  /* Uniform value in [0, 1). */
+  float unit() {
+    return (next() >> 8) * (1.0 / 16777216.0);
+  }
+
+  /* Skips delta outputs by composing the LCG step with itself, O(log delta).
+   */
+  void advance(uint64 delta) {
+    uint64 acc_mult = 1;
+    uint64 acc_plus = 0;
+    uint64 cur_mult = PCG_MULT;
+    uint64 cur_plus = inc;
+    while (delta > 0) {
+      if ((delta & 1) != 0) {
+        acc_mult *= cur_mult;
+        acc_plus = acc_plus * cur_mult + cur_plus;
+      }
+      cur_plus = (cur_mult + 1) * cur_plus;
+      cur_mult *= cur_mult;
+      delta >>= 1;
+    }
+    state = acc_mult * state + acc_plus;
+  }
+
+  void fill(array<uint>@ out) {
+    for (uint i = 0; i < out.size(); i++) {
+      out[i] = next();
+    }
+  }
+
+  void fill_range(array<int>@ out, int lo, int hi) {
+    for (uint i = 0; i < out.size(); i++) {
+      out[i] = range(lo, hi);
+    }
+  }
+
+  void fill_unit(array<float>@ out) {
+    for (uint i = 0; i < out.size(); i++) {
+      out[i] = unit();
+    }
+  }
+}
@@ -0,0 +1,188 @@
+#include "math.cpp"
+
+const float TILE_PIXELS = 48;
+
+/* Largest number of tiles probed to prove a batch can't hit anything before
+ * giving up and casting every ray. */
+const int RAY_BATCH_MAX_PROBE = 16;
+
+/* Usage:
+ *
+ * ray_batch casts groups of related collision layer rays and keeps the
+ * results in buffers owned by the batch, read back per ray with the raycast
+ * accessors taking the ray's index. Each query first checks the tiles under
+ * the bounding box of the whole group; when none of them is solid every ray
+ * misses and no rays are cast at all.
+ *
+ * fan() casts count rays from (x, y) out to a circle of the given radius,
+ * spread over the half circle facing dir the way blob probes around itself.
+ * sweep() casts count rays from those same points on the circle along
+ * (dx, dy). Ray ends come from lengthdir_x/y, so consumers recomputing a
+ * fan's edge points with them get the same floats. visible() casts a ray both ways between two points unless the
+ * tiles between them are all empty, and skips the return ray once the forward
+ * one hits.
+ *
+ * cast() fills a single slot, for consumers that move between rays of a fan.
+ * requested, cast_count and probes count what was asked for against what was
+ * done; stats() prints them.
+ */
+class ray_batch {
+  scene@ g;
+
+  uint count;
+  array<float> dirs;
+  array<bool> hits;
+  array<float> xs;
+  array<float> ys;
+  array<int> txs;
+  array<int> tys;
+  array<float> angles;
+
+  uint requested;
+  uint cast_count;
+  uint probes;
+
+  ray_batch(uint capacity = 8) {
+    @g = @get_scene();
+    count = 0;
+    requested = 0;
+    cast_count = 0;
+    probes = 0;
+    reserve(capacity);
+  }
+
+  void reserve(uint n) {
+    if (n <= hits.size()) {
+      return;
+    }
+    dirs.resize(n);
+    hits.resize(n);
+    xs.resize(n);
+    ys.resize(n);
+    txs.resize(n);
+    tys.resize(n);
+    angles.resize(n);
+  }
+
+  uint size() const { return count; }
+  float ray_dir(uint i) const { return dirs[i]; }
+  bool hit(uint i) const { return hits[i]; }
+  float hit_x(uint i) const { return xs[i]; }
+  float hit_y(uint i) const { return ys[i]; }
+  int tile_x(uint i) const { return txs[i]; }
+  int tile_y(uint i) const { return tys[i]; }
+  float angle(uint i) const { return angles[i]; }
+
+  /* Returns true if no tile overlapping the box is solid. Boxes covering more
+   * than RAY_BATCH_MAX_PROBE tiles aren't checked and return false. */
+  bool box_clear(float x1, float y1, float x2, float y2) {
+    int tx1 = int(floor(min(x1, x2) / TILE_PIXELS));
+    int ty1 = int(floor(min(y1, y2) / TILE_PIXELS));
+    int tx2 = int(floor(max(x1, x2) / TILE_PIXELS));
+    int ty2 = int(floor(max(y1, y2) / TILE_PIXELS));
+    if ((tx2 - tx1 + 1) * (ty2 - ty1 + 1) > RAY_BATCH_MAX_PROBE) {
+      return false;
+    }
+    for (int ty = ty1; ty <= ty2; ty++) {
+      for (int tx = tx1; tx <= tx2; tx++) {
+        if (solid(tx, ty)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  bool solid(int tx, int ty) {
+    probes++;
+    tileinfo@ ti = @g.get_tile(tx, ty, 19);
+    return @ti != null && ti.solid();
+  }
+
+  bool cast(uint i, float x1, float y1, float x2, float y2) {
+    cast_count++;
+    raycast@ rc = @g.ray_cast_tiles(x1, y1, x2, y2);
+    hits[i] = rc.hit();
+    if (hits[i]) {
+      xs[i] = rc.hit_x();
+      ys[i] = rc.hit_y();
+      txs[i] = rc.tile_x();
+      tys[i] = rc.tile_y();
+      angles[i] = rc.angle();
+    }
+    return hits[i];
+  }
+
+  void start(uint n) {
+    reserve(n);
+    count = n;
+    requested += n;
+    for (uint i = 0; i < n; i++) {
+      hits[i] = false;
+    }
+  }
+
+  float fan_dir(float dir, uint i, uint n) const {
+    return dir + 180.0 * (i + 1) / (n + 1) - 90;
+  }
+
+  /* Returns the number of rays that hit. */
+  int fan(float x, float y, float radius, float dir, uint n) {
+    start(n);
+    for (uint i = 0; i < n; i++) {
+      dirs[i] = fan_dir(dir, i, n);
+    }
+    if (box_clear(x - radius, y - radius, x + radius, y + radius)) {
+      return 0;
+    }
+    int num_hits = 0;
+    for (uint i = 0; i < n; i++) {
+      if (cast(i, x, y, x + lengthdir_x(radius, dirs[i]),
+               y + lengthdir_y(radius, dirs[i]))) {
+        num_hits++;
+      }
+    }
+    return num_hits;
+  }
+
+  /* Returns the number of rays that hit. */
+  int sweep(float x, float y, float radius, float dir, uint n,
+            float dx, float dy) {
+    start(n);
+    for (uint i = 0; i < n; i++) {
+      dirs[i] = fan_dir(dir, i, n);
+    }
+    if (box_clear(x - radius + min(dx, 0), y - radius + min(dy, 0),
+                  x + radius + max(dx, 0), y + radius + max(dy, 0))) {
+      return 0;
+    }
+    int num_hits = 0;
+    for (uint i = 0; i < n; i++) {
+      float edge_x = x + lengthdir_x(radius, dirs[i]);
+      float edge_y = y + lengthdir_y(radius, dirs[i]);
+      if (cast(i, edge_x, edge_y, edge_x + dx, edge_y + dy)) {
+        num_hits++;
+      }
+    }
+    return num_hits;
+  }
+
+  /* Slot 0 holds the forward ray and slot 1 the return ray. */
+  bool visible(float x1, float y1, float x2, float y2) {
+    start(2);
+    if (box_clear(x1, y1, x2, y2)) {
+      return true;
+    }
+    /* The engine only reports collidable edges facing the ray, so a clear
+     * forward ray proves nothing on its own. */
+    if (cast(0, x1, y1, x2, y2)) {
+      return false;
+    }
+    return !cast(1, x2, y2, x1, y1);
+  }
+
+  string stats() const {
+    return "" + requested + " rays requested, " + cast_count + " cast, " +
+           probes + " tiles probed";
+  }
+}
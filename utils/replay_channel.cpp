@@ -0,0 +1,307 @@
+#include "replay_encoder.cpp"
+
+/* Frames each packet is held for. Desync frames land at least every 8 frames
+ * while there is movement near the player, so a held packet is always seen.
+ */
+const uint CHANNEL_HOLD_FRAMES = 10;
+
+/* Set above the payload length in a packet's second header entity on the
+ * last and first packets of a message. */
+const uint CHANNEL_FLAG_END = 0x80;
+const uint CHANNEL_FLAG_START = 0x40;
+const uint CHANNEL_FLAGS = CHANNEL_FLAG_END | CHANNEL_FLAG_START;
+const uint CHANNEL_HEADER_WORDS = 2;
+
+/* A packet whose sequence number is less than this far ahead of the next
+ * expected one is taken as new, and any packets in between as lost. Anything
+ * else is an old packet still sitting on the entities. */
+const uint CHANNEL_SEQ_WINDOW = 128;
+
+/* Usage:
+ *
+ * Instantiate a replay_channel in your script, optionally passing the number
+ * of encoder entities to use (default 11), and call step() every time
+ * script.step is called.
+ *
+ * send() queues a byte buffer of any length as one message. Outside of
+ * replays queued messages are split into packets that are written onto the
+ * encoder entity positions one after another. Every frame, in and out of
+ * replays, the channel reads the entity positions back and appends any new
+ * packet to received, so the same messages show up in the same order in both
+ * cases. Call next_message() to pop each completed message.
+ *
+ * Packets use the replay_encoder word layout, one byte per entity in whole
+ * pixels. The first two entities of each packet are a header holding an 8
+ * bit sequence number, then the payload length with the CHANNEL_FLAGS; every
+ * other entity carries a payload byte. Every entity is tagged with the low
+ * bits of the sequence number so a frame that mixes two packets is ignored.
+ * With the default 11 entities that is 9 bytes per packet, one packet every
+ * CHANNEL_HOLD_FRAMES frames.
+ *
+ * A replay can miss a packet, e.g. when no desync frame lands while it is
+ * held. The receiver then takes the next packet within CHANNEL_SEQ_WINDOW,
+ * adds the gap to lost and calls on_lost(); the default queues drop the
+ * message the gap cut into and skip ahead to the next message start.
+ *
+ * Subclasses can replace the message queues by overriding fill_payload() and
+ * deliver() (and on_lost()), see replay_telemetry. replay_channel_test.cpp
+ * checks recovery from a dropped packet.
+ *
+ * Like replay_rand this relies on the player entity not moving much while
+ * data is in flight and fails if there is no player entity.
+ */
+class replay_channel {
+  uint num_encoders;
+  array<uint> encoders;
+  bool failed;
+
+  int ecx;
+  int ecy;
+  uint frame_counter;
+
+  uint send_seq;
+  uint recv_seq;
+  uint lost; /* Packets missed by the receiver */
+  uint hold_timer; /* Frames left before the next packet can be written */
+  array<uint8> packet; /* Payload of the packet being written or read */
+  array<uint> words; /* Scratch for the words of the packet being read */
+
+  /* Message queues used by the default fill_payload and deliver */
+  array<uint8> outgoing;
+  array<uint> outgoing_ends; /* End offset of each queued message */
+  uint send_pos;
+  bool sending; /* Set once the current message's first packet is out */
+  array<uint8> received;
+  array<uint> received_ends; /* End offset of each completed message */
+  uint read_pos;
+  bool skipping; /* Dropping packets until the next message starts */
+
+  replay_channel(uint num_encoders = 11) {
+    /* Payload lengths have to fit below the CHANNEL_FLAGS. */
+    this.num_encoders = max(CHANNEL_HEADER_WORDS + 1,
+                            min(CHANNEL_HEADER_WORDS + 63, num_encoders));
+    failed = false;
+    send_pos = 0;
+    send_seq = 0;
+    sending = false;
+    hold_timer = 0;
+    read_pos = 0;
+    skipping = false;
+    recv_seq = 0;
+    lost = 0;
+    packet.resize(payload_bytes());
+    words.resize(this.num_encoders);
+  }
+
+  uint payload_bytes() const {
+    return num_encoders - CHANNEL_HEADER_WORDS;
+  }
+
+  void send(array<uint8>@ bytes) {
+    for (uint i = 0; i < bytes.size(); i++) {
+      outgoing.insertLast(bytes[i]);
+    }
+    outgoing_ends.insertLast(outgoing.size());
+  }
+
+  /* True once everything sent has been written out. */
+  bool idle() const {
+    return outgoing_ends.size() == 0 && hold_timer == 0;
+  }
+
+  /* Pops the oldest completed message into bytes. Returns false if there is
+   * none. */
+  bool next_message(array<uint8>@ bytes) {
+    if (received_ends.size() == 0) {
+      return false;
+    }
+    uint end = received_ends[0];
+    bytes.resize(end - read_pos);
+    for (uint i = read_pos; i < end; i++) {
+      bytes[i - read_pos] = received[i];
+    }
+    received_ends.removeAt(0);
+    read_pos = end;
+    if (received_ends.size() == 0) {
+      /* Keep any partly received message. */
+      for (uint i = end; i < received.size(); i++) {
+        received[i - end] = received[i];
+      }
+      received.resize(received.size() - end);
+      read_pos = 0;
+    }
+    return true;
+  }
+
+  void step() {
+    if (failed) {
+      return;
+    }
+    if (encoders.size() == 0) {
+      init_encoders();
+      return;
+    }
+    if (hold_timer > 0) {
+      hold_timer--;
+    }
+    if (hold_timer == 0 && !is_replay()) {
+      write_packet();
+    }
+    read_packet();
+    ++frame_counter;
+  }
+
+  void init_encoders() {
+    controllable@ ec = @controller_controllable(0);
+    if (@ec == null) {
+      puts("no entity attached to controller 0, channel failed");
+      failed = true;
+      return;
+    }
+
+    ecx = int(ec.x());
+    ecy = int(ec.y());
+    encoder_spawn(ecx, ecy, num_encoders, @encoders);
+  }
+
+  /* Copies the next packet's payload into packet, returning the number of
+   * bytes and the header flags, or -1 if there is nothing to send. Override
+   * to feed the channel from another source. */
+  int fill_payload(uint &out flags) {
+    flags = 0;
+    if (outgoing_ends.size() == 0) {
+      return -1;
+    }
+    uint msg_end = outgoing_ends[0];
+    uint count = min(payload_bytes(), msg_end - send_pos);
+    for (uint i = 0; i < count; i++) {
+      packet[i] = outgoing[send_pos + i];
+    }
+    send_pos += count;
+    if (!sending) {
+      flags |= CHANNEL_FLAG_START;
+      sending = true;
+    }
+    if (send_pos == msg_end) {
+      flags |= CHANNEL_FLAG_END;
+      sending = false;
+      outgoing_ends.removeAt(0);
+      if (outgoing_ends.size() == 0) {
+        outgoing.resize(0);
+        send_pos = 0;
+      }
+    }
+    return int(count);
+  }
+
+  /* Takes the payload of a received packet from packet. Override along with
+   * fill_payload. */
+  void deliver(uint count, uint flags) {
+    if (skipping && (flags & CHANNEL_FLAG_START) == 0) {
+      return;
+    }
+    skipping = false;
+    for (uint i = 0; i < count; i++) {
+      received.insertLast(packet[i]);
+    }
+    if ((flags & CHANNEL_FLAG_END) != 0) {
+      received_ends.insertLast(received.size());
+    }
+  }
+
+  void write_packet() {
+    uint flags;
+    int count = fill_payload(flags);
+    if (count < 0) {
+      return;
+    }
+    for (uint i = 0; i < num_encoders; i++) {
+      uint word = 0;
+      if (i == 0) {
+        word = send_seq & 0xFF;
+      } else if (i == 1) {
+        word = uint(count) | flags;
+      } else if (i - CHANNEL_HEADER_WORDS < uint(count)) {
+        word = packet[i - CHANNEL_HEADER_WORDS];
+      }
+      if (!write_word(i, word)) {
+        return;
+      }
+    }
+
+    send_seq++;
+    hold_timer = CHANNEL_HOLD_FRAMES;
+  }
+
+  bool write_word(uint i, uint word) {
+    entity@ ent = @entity_by_id(encoders[i]);
+    if (@ent == null) {
+      puts("entity missing, channel write failed");
+      failed = true;
+      return false;
+    }
+    encoder_write_word(@ent, ecx, ecy, word, send_seq);
+    return true;
+  }
+
+  /* Reads the word and tag held by encoder i, or returns false if the entity
+   * is still at its spawn position. */
+  bool read_word(uint i, uint &out word, uint &out tag) {
+    entity@ ent = @entity_by_id(encoders[i]);
+    if (@ent == null) {
+      puts("entity missing, channel read failed");
+      failed = true;
+      return false;
+    }
+    return encoder_read_word(@ent, ecx, ecy, word, tag);
+  }
+
+  /* Called with the number of packets the receiver missed, before the
+   * packet after them is delivered. Override along with deliver. */
+  void on_lost(uint count) {
+    /* Drop the message the gap cut into. */
+    uint start = received_ends.size() == 0 ? read_pos :
+        received_ends[received_ends.size() - 1];
+    received.resize(start);
+    skipping = true;
+  }
+
+  void read_packet() {
+    uint seq;
+    uint tag;
+    if (!read_word(0, seq, tag) || tag != (seq & ENCODER_TAG_MASK) ||
+        ((seq - recv_seq) & 0xFF) >= CHANNEL_SEQ_WINDOW) {
+      /* Nothing written yet or the packet was already read. */
+      return;
+    }
+    for (uint i = 1; i < num_encoders; i++) {
+      uint word_tag;
+      if (!read_word(i, words[i], word_tag) || word_tag != tag) {
+        /* Part of the frame still holds another packet. */
+        return;
+      }
+    }
+    uint count = min(payload_bytes(), words[1] & ~CHANNEL_FLAGS);
+    for (uint i = 0; i < count; i++) {
+      packet[i] = uint8(words[CHANNEL_HEADER_WORDS + i]);
+    }
+    receive(seq, count, words[1] & CHANNEL_FLAGS);
+  }
+
+  /* Takes the packet in packet with 8 bit sequence number seq. Returns false
+   * if it is an old packet. */
+  bool receive(uint seq, uint count, uint flags) {
+    uint ahead = (seq - recv_seq) & 0xFF;
+    if (ahead >= CHANNEL_SEQ_WINDOW) {
+      return false;
+    }
+    if (ahead != 0) {
+      lost += ahead;
+      recv_seq += ahead;
+      on_lost(ahead);
+    }
+    recv_seq++;
+    deliver(count, flags);
+    return true;
+  }
+}
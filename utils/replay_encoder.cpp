@@ -0,0 +1,337 @@
+/* Each encoder entity carries one byte, stored the way replay_rand always
+ * stored its seed: a whole pixel x offset of ENCODER_X_BASE + byte from the
+ * anchor. The y offset is ENCODER_Y_BASE plus a small tag, also in whole
+ * pixels, which marks the entity as moved and says which write it holds so a
+ * frame mixing two writes can be told apart. Nothing depends on desync frames
+ * restoring sub-pixel positions.
+ */
+const uint ENCODER_WORD_BITS = 8;
+const uint ENCODER_WORD_MASK = 0xFF;
+const int ENCODER_X_BASE = -128;
+const int ENCODER_Y_BASE = 100;
+const uint ENCODER_TAG_MASK = 0xF;
+
+/* Frame values are encoded on. Encoder entities are added on the first step
+ * and need a frame in the scene before they can be moved. */
+const uint ENCODER_ENCODE_FRAME = 1;
+
+/* Values are written ENCODER_ATTEMPTS times, ENCODER_RETRY_FRAMES frames
+ * apart, so a replay that misses or mangles one desync frame can recover them
+ * from a later attempt. Desync frames land at least every 8 frames while
+ * there is movement near the player. */
+const uint ENCODER_ATTEMPTS = 4;
+const uint ENCODER_RETRY_FRAMES = 10;
+
+/* Frame after which undecoded values are given up on. */
+const uint ENCODER_TIMEOUT = ENCODER_ENCODE_FRAME +
+                             ENCODER_ATTEMPTS * ENCODER_RETRY_FRAMES + 10;
+
+/* A 16-bit checksum of the data words follows them, one byte per entity.
+ * Every entity of an attempt is tagged with the attempt number. */
+const uint ENCODER_CHECK_WORDS = 2;
+const uint ENCODER_CHECK_BITS = ENCODER_CHECK_WORDS * ENCODER_WORD_BITS;
+const uint ENCODER_CHECK_MASK = (1 << ENCODER_CHECK_BITS) - 1;
+
+/* Totals across every replay_encoder since the script was loaded, to gauge
+ * how often decoding needs a retry or fails outright. */
+uint encoder_decodes = 0;
+uint encoder_retries = 0;
+uint encoder_corrupt_reads = 0;
+uint encoder_failures = 0;
+
+string encoder_stats() {
+  return "replay encoder: " + encoder_decodes + " decoded, " +
+         encoder_failures + " failed, " + encoder_retries + " retries, " +
+         encoder_corrupt_reads + " corrupt frames";
+}
+
+enum RecorderState {
+  INIT = 0,
+  ENCODED = 1,
+  DONE = 2,
+  FAILED = 3
+};
+
+/* Moves ent to hold word, tagged with tag, relative to the anchor
+ * (ecx, ecy). */
+void encoder_write_word(entity@ ent, int ecx, int ecy, uint word,
+                        uint tag = 0) {
+  ent.x(ecx + ENCODER_X_BASE + int(word & ENCODER_WORD_MASK));
+  ent.y(ecy + ENCODER_Y_BASE + int(tag & ENCODER_TAG_MASK));
+}
+
+/* Reads the word and tag held by ent, or returns false if it is still at its
+ * spawn position. */
+bool encoder_read_word(entity@ ent, int ecx, int ecy, uint &out word,
+                       uint &out tag) {
+  int dy = int(round(ent.y())) - ecy;
+  if (dy < ENCODER_Y_BASE / 2) {
+    return false;
+  }
+  word = uint(int(round(ent.x())) - ecx - ENCODER_X_BASE) & ENCODER_WORD_MASK;
+  tag = uint(dy - ENCODER_Y_BASE) & ENCODER_TAG_MASK;
+  return true;
+}
+
+/* FNV-1a over the first count words, folded to ENCODER_CHECK_BITS. */
+uint encoder_checksum(array<uint>@ words, uint count) {
+  uint h = 2166136261;
+  for (uint i = 0; i < count; i++) {
+    h = (h ^ (words[i] & ENCODER_WORD_MASK)) * 16777619;
+  }
+  return (h ^ (h >> ENCODER_CHECK_BITS)) & ENCODER_CHECK_MASK;
+}
+
+/* Spawns count encoder entities at (ecx, ecy), appending their ids. */
+void encoder_spawn(int ecx, int ecy, uint count, array<uint>@ ids) {
+  scene@ g = @get_scene();
+  for (uint i = 0; i < count; i++) {
+    scriptenemy@ ent = create_scriptenemy(replay_encoder_dummy());
+    ent.x(ecx);
+    ent.y(ecy);
+    g.add_entity(@ent.as_entity());
+    ids.insertLast(ent.id());
+  }
+}
+
+interface replay_consumer {
+  /* Value to record, called once outside of replays when values are
+   * encoded. Only the low bits registered with the encoder are kept. */
+  uint encode_value();
+
+  /* Called with the recovered value, live and in replays. */
+  void on_decoded(uint value);
+
+  /* Called if the value could not be recorded or recovered. */
+  void on_failed();
+}
+
+/* Usage:
+ *
+ * Create one replay_encoder per script and call step() on it every time
+ * script.step is called. Before the first step, every consumer that needs
+ * values recorded in the replay calls add() with the number of bits it
+ * needs (up to 32). All the consumers share one set of encoder entities,
+ * ENCODER_WORD_BITS bits per entity, and one schedule.
+ *
+ * On frame 1 outside of replays each consumer's encode_value() is written
+ * onto the entities along with ENCODER_CHECK_WORDS checksum entities, all
+ * tagged with the attempt number, and rewritten every
+ * ENCODER_RETRY_FRAMES frames for ENCODER_ATTEMPTS attempts. From frame 1 on
+ * the entities are polled every frame and as soon as they have all been moved
+ * with one tag and a matching checksum (straight away live, on the next good
+ * desync frame in replays) each consumer gets its value through
+ * on_decoded(). Partial or corrupted frames are never passed on. state goes INIT -> ENCODED -> DONE,
+ * or to FAILED in which case every consumer's on_failed() is called.
+ * encoder_stats() summarizes retries and failures.
+ *
+ * This can potentially fail if there is no player entity or if the player
+ * entity moves significantly before the values are decoded (dustman free fall
+ * should be fine but entering a zip would probably break things).
+ */
+class replay_encoder {
+  array<uint> encoders; /* Data entities followed by the checksum entities */
+  RecorderState state;
+
+  array<replay_consumer@> consumers;
+  array<uint> widths;
+  uint total_bits;
+
+  array<uint> words; /* Encoded data words, reused for every attempt */
+  array<uint> read_words; /* Scratch for the words read back each frame */
+  array<uint> read_tags;
+  uint attempt; /* Attempts written so far */
+  uint last_bad_check;
+
+  /* Statistics for this encoder */
+  uint decode_attempt; /* Attempt the values were recovered from */
+  uint corrupt_reads; /* Distinct frames read back with a bad checksum */
+
+  int ecx;
+  int ecy;
+  uint frame_counter;
+
+  replay_encoder() {
+    state = RecorderState::INIT;
+    total_bits = 0;
+    attempt = 0;
+    last_bad_check = 0;
+    decode_attempt = 0;
+    corrupt_reads = 0;
+    frame_counter = 0;
+  }
+
+  /* Registers a consumer needing bits bits. Returns false, and calls the
+   * consumer's on_failed(), if entities have already been allocated. */
+  bool add(replay_consumer@ consumer, uint bits) {
+    if (encoders.size() != 0 || state == RecorderState::FAILED) {
+      consumer.on_failed();
+      return false;
+    }
+    consumers.insertLast(@consumer);
+    widths.insertLast(min(32, bits));
+    total_bits += min(32, bits);
+    return true;
+  }
+
+  void step() {
+    if (state == RecorderState::FAILED || consumers.size() == 0) {
+      return;
+    }
+    if (state == RecorderState::DONE &&
+        (is_replay() || attempt == ENCODER_ATTEMPTS)) {
+      return;
+    }
+    if (encoders.size() == 0) {
+      if (!init_encoders()) {
+        fail();
+      }
+      return;
+    }
+    if (frame_counter >= ENCODER_ENCODE_FRAME &&
+        (frame_counter - ENCODER_ENCODE_FRAME) % ENCODER_RETRY_FRAMES == 0 &&
+        attempt < ENCODER_ATTEMPTS) {
+      /* Outside of replays every attempt is written, even once decoded
+       * live, so a replay that loses one still has the next. */
+      if (!is_replay() && !encode()) {
+        fail();
+        return;
+      }
+      attempt++;
+      if (state == RecorderState::INIT) {
+        state = RecorderState::ENCODED;
+      }
+    }
+    if (state == RecorderState::ENCODED) {
+      /* Poll every frame; values are read back as soon as every encoder
+       * has left its spawn position with a matching checksum. */
+      try_decode();
+    }
+    ++frame_counter;
+  }
+
+  bool init_encoders() {
+    controllable@ ec = @controller_controllable(0);
+    if (@ec == null) {
+      puts("no entity attached to controller 0, encode failed");
+      return false;
+    }
+
+    ecx = int(ec.x());
+    ecy = int(ec.y());
+    uint data = (total_bits + ENCODER_WORD_BITS - 1) / ENCODER_WORD_BITS;
+    encoder_spawn(ecx, ecy, data + ENCODER_CHECK_WORDS, @encoders);
+    words.resize(data);
+    read_words.resize(data + ENCODER_CHECK_WORDS);
+    read_tags.resize(data + ENCODER_CHECK_WORDS);
+    return true;
+  }
+
+  bool encode() {
+    if (attempt == 0) {
+      for (uint i = 0; i < words.size(); i++) {
+        words[i] = 0;
+      }
+      uint pos = 0;
+      for (uint i = 0; i < consumers.size(); i++) {
+        uint value = consumers[i].encode_value();
+        for (uint b = 0; b < widths[i]; b++) {
+          if ((value & (uint(1) << b)) != 0) {
+            words[pos / ENCODER_WORD_BITS] |= uint(1) << (pos % ENCODER_WORD_BITS);
+          }
+          pos++;
+        }
+      }
+    }
+
+    uint data = words.size();
+    uint check = encoder_checksum(@words, data);
+    for (uint i = 0; i < encoders.size(); i++) {
+      entity@ ent = @entity_by_id(encoders[i]);
+      if (@ent == null) {
+        puts("entity missing, encoding failed");
+        return false;
+      }
+      uint word = i < data ? words[i] :
+          check >> ((i - data) * ENCODER_WORD_BITS);
+      encoder_write_word(@ent, ecx, ecy, word, attempt);
+    }
+    return true;
+  }
+
+  void try_decode() {
+    for (uint i = 0; i < encoders.size(); i++) {
+      entity@ ent = @entity_by_id(encoders[i]);
+      if (@ent == null) {
+        puts("entity missing, reconstruction failed");
+        fail();
+        return;
+      }
+      if (!encoder_read_word(@ent, ecx, ecy, read_words[i], read_tags[i])) {
+        /* Desync frame hasn't landed yet. */
+        check_timeout();
+        return;
+      }
+    }
+
+    uint data = words.size();
+    uint check = 0;
+    bool same_tag = true;
+    for (uint i = 0; i < ENCODER_CHECK_WORDS; i++) {
+      check |= read_words[data + i] << (i * ENCODER_WORD_BITS);
+    }
+    for (uint i = 1; i < encoders.size(); i++) {
+      same_tag = same_tag && read_tags[i] == read_tags[0];
+    }
+    if (!same_tag || check != encoder_checksum(@read_words, data)) {
+      /* Partial or corrupted frame; wait for the next attempt. Only count
+       * each bad frame once while it stays on the entities. */
+      uint bad = check | (read_tags[0] << ENCODER_CHECK_BITS);
+      if (bad != last_bad_check) {
+        last_bad_check = bad;
+        corrupt_reads++;
+        encoder_corrupt_reads++;
+      }
+      check_timeout();
+      return;
+    }
+
+    state = RecorderState::DONE;
+    decode_attempt = read_tags[0];
+    encoder_decodes++;
+    encoder_retries += decode_attempt;
+    uint pos = 0;
+    for (uint i = 0; i < consumers.size(); i++) {
+      uint value = 0;
+      for (uint b = 0; b < widths[i]; b++) {
+        uint word = read_words[pos / ENCODER_WORD_BITS];
+        if ((word & (uint(1) << (pos % ENCODER_WORD_BITS))) != 0) {
+          value |= uint(1) << b;
+        }
+        pos++;
+      }
+      consumers[i].on_decoded(value);
+    }
+  }
+
+  void check_timeout() {
+    if (frame_counter >= ENCODER_TIMEOUT) {
+      puts("no valid frame after " + attempt + " attempts, reconstruction failed");
+      fail();
+    }
+  }
+
+  void fail() {
+    state = RecorderState::FAILED;
+    encoder_failures++;
+    for (uint i = 0; i < consumers.size(); i++) {
+      consumers[i].on_failed();
+    }
+  }
+}
+
+class replay_encoder_dummy : enemy_base {
+  void init(script@, scriptenemy@ self) {
+    self.auto_physics(false);
+  }
+}
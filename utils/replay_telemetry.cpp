@@ -0,0 +1,105 @@
+#include "replay_channel.cpp"
+
+/* Usage:
+ *
+ * Instantiate a replay_telemetry in your script, optionally passing the number
+ * of encoder entities and the queue capacity, and call step() every time
+ * script.step is called. The encoder entities stay alive for the whole level.
+ *
+ * push() appends a 32-bit value (a reseed, a timer sample, a decision) to the
+ * outgoing queue. Queued values are written out a packet at a time, as many as
+ * fit in one packet (2 with the default 10 entities) every CHANNEL_HOLD_FRAMES
+ * frames. pop() returns the values read back from the encoders in the order
+ * they were pushed, both live and in replays. In replays push() is ignored
+ * since the values come from the replay instead.
+ *
+ * Both queues are fixed size rings allocated up front. Values pushed onto a
+ * full queue, or received into a full one, are dropped and counted in
+ * dropped.
+ */
+class replay_telemetry : replay_channel {
+  array<uint> out_ring;
+  uint out_head;
+  uint out_count;
+
+  array<uint> in_ring;
+  uint in_head;
+  uint in_count;
+
+  uint dropped;
+
+  replay_telemetry(uint num_encoders = 10, uint capacity = 256) {
+    /* At least one whole value has to fit in a packet. */
+    super(max(CHANNEL_HEADER_WORDS + 4, num_encoders));
+    out_ring.resize(capacity);
+    in_ring.resize(capacity);
+    out_head = out_count = 0;
+    in_head = in_count = 0;
+    dropped = 0;
+  }
+
+  bool push(uint value) {
+    if (is_replay()) {
+      return true;
+    }
+    if (out_count == out_ring.size()) {
+      dropped++;
+      return false;
+    }
+    out_ring[(out_head + out_count) % out_ring.size()] = value;
+    out_count++;
+    return true;
+  }
+
+  /* Number of received values waiting to be popped. */
+  uint available() const {
+    return in_count;
+  }
+
+  bool pop(uint &out value) {
+    if (in_count == 0) {
+      return false;
+    }
+    value = in_ring[in_head];
+    in_head = (in_head + 1) % in_ring.size();
+    in_count--;
+    return true;
+  }
+
+  int fill_payload(uint &out flags) override {
+    flags = 0;
+    uint n = min(payload_bytes() / 4, out_count);
+    if (n == 0) {
+      return -1;
+    }
+    for (uint i = 0; i < n; i++) {
+      uint value = out_ring[out_head];
+      out_head = (out_head + 1) % out_ring.size();
+      for (uint b = 0; b < 4; b++) {
+        packet[i * 4 + b] = uint8((value >> (b * 8)) & 0xFF);
+      }
+    }
+    out_count -= n;
+    return int(n * 4);
+  }
+
+  void on_lost(uint count) override {
+    /* Values never span packets, so those after a gap arrive whole; the
+     * missing ones are counted in lost by the channel. */
+  }
+
+  void deliver(uint count, uint flags) override {
+    for (uint i = 0; i + 4 <= count; i += 4) {
+      uint value = 0;
+      for (uint b = 0; b < 4; b++) {
+        value |= uint(packet[i + b]) << (b * 8);
+      }
+      if (in_count == in_ring.size()) {
+        dropped++;
+        continue;
+      }
+      in_ring[(in_head + in_count) % in_ring.size()] = value;
+      in_count++;
+    }
+  }
+}
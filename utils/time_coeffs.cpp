@@ -0,0 +1,90 @@
+/* Kinds of coefficient, each derived from a base value x */
+const int COEFF_INC = 0; /* x per frame: x / 60 * time_warp */
+const int COEFF_S = 1; /* x * scale */
+const int COEFF_S_INC = 2; /* x per frame, scaled */
+const int COEFF_POW_INC = 3; /* Decay of x per second over a frame */
+
+/* Usage:
+ *
+ * time_coeffs caches values that depend only on an entity's time warp and
+ * scale, so steady frames don't redo the divisions and pow() calls behind
+ * them. Give each coefficient a slot with set(slot, kind, x), typically from
+ * an enum, then call update(time_warp, scale) at the top of step() (and
+ * draw(), if it reads any) and read coefficients back with get(slot). The
+ * table is only rebuilt when the time warp, scale or a set() value changes.
+ *
+ * Values are computed with the same expressions entities used inline, so
+ * switching to the cache leaves their physics bit for bit the same. frame is
+ * time_warp / 60, the length of the frame in seconds.
+ */
+class time_coeffs {
+  float warp;
+  float scale;
+  float frame;
+  bool dirty;
+
+  array<int> kinds;
+  array<float> bases;
+  array<double> values;
+
+  time_coeffs() {
+    warp = 1;
+    scale = 1;
+    frame = warp / 60.0;
+    dirty = true;
+  }
+
+  void set(uint slot, int kind, float x) {
+    if (slot >= kinds.size()) {
+      kinds.resize(slot + 1);
+      bases.resize(slot + 1);
+      values.resize(slot + 1);
+    } else if (kinds[slot] == kind && bases[slot] == x) {
+      return;
+    }
+    kinds[slot] = kind;
+    bases[slot] = x;
+    dirty = true;
+  }
+
+  /* Returns true if the table was rebuilt. */
+  bool update(float warp, float scale) {
+    if (!dirty && warp == this.warp && scale == this.scale) {
+      return false;
+    }
+    this.warp = warp;
+    this.scale = scale;
+    frame = warp / 60.0;
+    for (uint i = 0; i < kinds.size(); i++) {
+      values[i] = compute(kinds[i], bases[i]);
+    }
+    dirty = false;
+    return true;
+  }
+
+  float get(uint slot) const {
+    return float(values[slot]);
+  }
+
+  /* The value before rounding to float, for the POW_INC kind. */
+  double get_double(uint slot) const {
+    return values[slot];
+  }
+
+  float inc(float x) const {
+    return x / 60.0 * warp;
+  }
+
+  double compute(int kind, float x) const {
+    if (kind == COEFF_INC) {
+      return inc(x);
+    } else if (kind == COEFF_S) {
+      return x * scale;
+    } else if (kind == COEFF_S_INC) {
+      return inc(x) * scale;
+    } else if (kind == COEFF_POW_INC) {
+      return pow(x, inc(1));
+    }
+    return 0;
+  }
+}